@@ -0,0 +1,162 @@
+#include "devices/lapic.h"
+#include <debug.h>
+#include <stdint.h>
+#include "threads/init.h"
+#include "threads/mmu.h"
+#include "threads/pte.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+
+/* Local APIC, for its timer.  See [IA32-v3a] chapter 10
+   "Advanced Programmable Interrupt Controller (APIC)".
+
+   External interrupts keep arriving through the 8259A PICs,
+   which the LAPIC passes through its LINT0 pin in "virtual wire"
+   mode; only the LAPIC's own timer interrupts on a LAPIC
+   vector. */
+
+/* IA32_APIC_BASE model-specific register. */
+#define MSR_APIC_BASE 0x1b
+#define APIC_BASE_ENABLE (1 << 11)      /* Global enable. */
+
+/* Register offsets, in bytes. */
+#define LAPIC_ID 0x020                  /* Local APIC ID. */
+#define LAPIC_EOI 0x0b0                 /* End of interrupt. */
+#define LAPIC_SVR 0x0f0                 /* Spurious interrupt vector. */
+#define LAPIC_ICR_LO 0x300              /* Interrupt command, low half. */
+#define LAPIC_ICR_HI 0x310              /* Interrupt command, high half. */
+#define LAPIC_LVT_TIMER 0x320           /* LVT timer. */
+#define LAPIC_LVT_LINT0 0x350           /* LVT LINT0 pin. */
+#define LAPIC_LVT_LINT1 0x360           /* LVT LINT1 pin. */
+#define LAPIC_TIMER_INIT 0x380          /* Timer initial count. */
+#define LAPIC_TIMER_CUR 0x390           /* Timer current count. */
+#define LAPIC_TIMER_DIV 0x3e0           /* Timer divide configuration. */
+
+#define SVR_ENABLE (1 << 8)             /* APIC software enable. */
+#define LVT_MASKED (1 << 16)            /* Interrupt masked. */
+#define LVT_EXTINT (7 << 8)             /* Delivery mode ExtINT. */
+#define LVT_NMI (4 << 8)                /* Delivery mode NMI. */
+#define TIMER_DIV_16 0x3                /* Divide bus clock by 16. */
+#define ICR_PENDING (1 << 12)           /* Delivery status: send pending. */
+#define ICR_ALL_BUT_SELF (3 << 18)      /* Destination shorthand. */
+
+/* Mapped LAPIC registers, or NULL if there is no LAPIC. */
+static volatile uint8_t *lapic;
+
+static uint32_t
+lapic_read (int reg) {
+	return *(volatile uint32_t *) (lapic + reg);
+}
+
+static void
+lapic_write (int reg, uint32_t value) {
+	*(volatile uint32_t *) (lapic + reg) = value;
+}
+
+/* Detects and enables the local APIC, mapping its registers
+   uncached into the kernel's address space.  Returns false,
+   leaving the PICs as the only interrupt source, if the CPU has
+   no LAPIC. */
+bool
+lapic_init (void) {
+	uint32_t eax, ebx, ecx, edx;
+	uint64_t base, pa;
+	uint64_t *pte;
+
+	cpuid (1, &eax, &ebx, &ecx, &edx);
+	if (!(edx & (1 << 9)))
+		return false;
+
+	base = read_msr (MSR_APIC_BASE);
+	if (!(base & APIC_BASE_ENABLE))
+		write_msr (MSR_APIC_BASE, base | APIC_BASE_ENABLE);
+	pa = base & ~(uint64_t) PGMASK & 0xffffffffffULL;
+
+	/* The mapping lives under base_pml4's kernel half, which every
+	   process's page map shares. */
+	pte = pml4e_walk (base_pml4, (uint64_t) ptov (pa), 1);
+	if (pte == NULL)
+		return false;
+	*pte = pa | PTE_P | PTE_W | PTE_PCD | PTE_PWT;
+	lapic = ptov (pa);
+
+	/* Keep the PICs wired through, and keep the timer quiet until
+	   someone starts it. */
+	lapic_write (LAPIC_LVT_LINT0, LVT_EXTINT);
+	lapic_write (LAPIC_LVT_LINT1, LVT_NMI);
+	lapic_write (LAPIC_LVT_TIMER, LVT_MASKED | LAPIC_TIMER_VEC);
+	lapic_write (LAPIC_TIMER_DIV, TIMER_DIV_16);
+	lapic_write (LAPIC_SVR, SVR_ENABLE | LAPIC_SPURIOUS_VEC);
+	return true;
+}
+
+/* Enables the local APIC of an application processor, whose
+   registers appear at the same address as the BSP's.  Unlike the
+   BSP's, its LINT0 stays masked: PIC interrupts go to the BSP
+   only. */
+void
+lapic_init_ap (void) {
+	ASSERT (lapic != NULL);
+	lapic_write (LAPIC_LVT_LINT0, LVT_MASKED | LVT_EXTINT);
+	lapic_write (LAPIC_LVT_LINT1, LVT_NMI);
+	lapic_write (LAPIC_LVT_TIMER, LVT_MASKED | LAPIC_TIMER_VEC);
+	lapic_write (LAPIC_SVR, SVR_ENABLE | LAPIC_SPURIOUS_VEC);
+}
+
+/* Returns the running CPU's local APIC ID. */
+uint8_t
+lapic_id (void) {
+	ASSERT (lapic != NULL);
+	return lapic_read (LAPIC_ID) >> 24;
+}
+
+/* Sends the interprocessor interrupt described by ICR, the low
+   half of the interrupt command register less its destination
+   shorthand, to every CPU but this one, and waits for it to be
+   delivered. */
+void
+lapic_ipi_others (uint32_t icr) {
+	ASSERT (lapic != NULL);
+	lapic_write (LAPIC_ICR_HI, 0);
+	lapic_write (LAPIC_ICR_LO, icr | ICR_ALL_BUT_SELF);
+	while (lapic_read (LAPIC_ICR_LO) & ICR_PENDING)
+		continue;
+}
+
+/* Returns true if lapic_init() found a LAPIC. */
+bool
+lapic_present (void) {
+	return lapic != NULL;
+}
+
+/* Acknowledges the LAPIC interrupt being serviced. */
+void
+lapic_eoi (void) {
+	ASSERT (lapic != NULL);
+	lapic_write (LAPIC_EOI, 0);
+}
+
+/* Starts the LAPIC timer in one-shot mode, to interrupt on
+   LAPIC_TIMER_VEC after COUNT timer counts. */
+void
+lapic_timer_start (uint32_t count) {
+	ASSERT (lapic != NULL);
+	lapic_write (LAPIC_LVT_TIMER, LAPIC_TIMER_VEC);
+	lapic_write (LAPIC_TIMER_INIT, count);
+}
+
+/* Returns the LAPIC timer's current count, which falls to 0 when
+   the one-shot expires. */
+uint32_t
+lapic_timer_count (void) {
+	ASSERT (lapic != NULL);
+	return lapic_read (LAPIC_TIMER_CUR);
+}
+
+/* Stops the LAPIC timer without raising an interrupt. */
+void
+lapic_timer_stop (void) {
+	ASSERT (lapic != NULL);
+	lapic_write (LAPIC_LVT_TIMER, LVT_MASKED | LAPIC_TIMER_VEC);
+	lapic_write (LAPIC_TIMER_INIT, 0);
+}
@@ -3,10 +3,14 @@
 #include <inttypes.h>
 #include <round.h>
 #include <stdio.h>
+#include "devices/lapic.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/profile.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/workqueue.h"
+#include "intrinsic.h"
 
 /* See [8254] for hardware details of the 8254 timer chip. */
 
@@ -17,14 +21,97 @@
 #error TIMER_FREQ <= 1000 recommended
 #endif
 
+/* 8254 input frequency divided by TIMER_FREQ, rounded to
+   nearest: the number of PIT counts in one tick. */
+#define PIT_HZ 1193180
+#define PIT_COUNT ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* If true, stop the periodic tick while idle.  Controlled by
+   kernel command-line option "-tickless". */
+bool timer_tickless;
+
+/* Tickless idle state.  While ONESHOT is true the periodic tick
+   is stopped and a one-shot interrupt is due, after which the
+   ticks that were skipped are made up for.
+
+   With a LAPIC, the one-shot runs on the LAPIC timer, which
+   counts far enough for any idle period, and the PIT's IRQ is
+   masked meanwhile; the skipped ticks are then measured on the
+   TSC.  Without one, the PIT itself goes into one-shot mode 0,
+   due to interrupt after ONESHOT_TICKS ticks' worth of counts,
+   which its 16-bit counter limits to PIT_ONESHOT_MAX_TICKS. */
+static bool oneshot;
+static bool oneshot_lapic;
+static unsigned oneshot_ticks;
+static unsigned oneshot_counts;
+
+/* Longest one-shot period, in ticks, that fits the PIT's 16-bit
+   counter. */
+#define PIT_ONESHOT_MAX_TICKS (0xffff / PIT_COUNT)
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+#define NSEC_PER_SEC 1000000000LL
+#define NSEC_PER_TICK (NSEC_PER_SEC / TIMER_FREQ)
+
+/* TSC clock, calibrated against the PIT by timer_calibrate().
+   Until then TSC_HZ is 0 and timer_now_ns() counts whole
+   ticks. */
+#define CAL_TICKS 8                     /* Ticks to calibrate over. */
+static uint64_t tsc_hz;                 /* TSC cycles per second. */
+static uint64_t tsc_epoch;              /* TSC at tick EPOCH_TICKS. */
+static int64_t epoch_ticks;
+
+/* LAPIC timer counts per second, or 0 if there is no LAPIC. */
+static uint64_t lapic_hz;
+
+/* Threads in sub-tick sleeps, in order of their deadline, kept in
+   `wait_time' in nanoseconds.  The LAPIC timer is always armed
+   for the first one. */
+static struct list hr_sleepers;
+
+/* Sleeps shorter than this spin instead of blocking, since a
+   block costs about as much. */
+#define HR_SPIN_NS 2000
+
+/* Sleeping threads live in a hierarchical timing wheel, linked
+   through their `elem' and keyed on their `wait_time'.  Level 0
+   has one slot per tick for the next 256 ticks; each of the three
+   upper levels has 64 slots, each 64 times coarser than a slot of
+   the level below.  Each time level 0 wraps, the next slot of
+   level 1 is cascaded down into it, and likewise upward, so every
+   tick does O(1) work plus the number of expirations. */
+#define WHEEL0_BITS 8
+#define WHEELN_BITS 6
+#define WHEEL0_SIZE (1 << WHEEL0_BITS)
+#define WHEELN_SIZE (1 << WHEELN_BITS)
+#define WHEEL_LEVELS 3                  /* Levels above level 0. */
+#define WHEEL_SPAN (1LL << (WHEEL0_BITS + WHEEL_LEVELS * WHEELN_BITS))
+
+static struct list wheel0[WHEEL0_SIZE];
+static struct list wheeln[WHEEL_LEVELS][WHEELN_SIZE];
+
+/* Next tick the wheel will process.  Never more than one past
+   `ticks'. */
+static int64_t wheel_time;
+
 static intr_handler_func timer_interrupt;
+static intr_handler_func hrtimer_interrupt;
+static void hr_sleep (int64_t ns);
+static void hr_arm (void);
+static bool hr_less (const struct list_elem *, const struct list_elem *,
+		void *aux);
+static void oneshot_end (unsigned elapsed, bool user);
+static void pit_program (uint8_t mode, uint16_t count);
+static uint16_t pit_read (void);
+static void wheel_insert (struct thread *);
+static int wheel_cascade (int level);
+static void wheel_advance (void);
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
@@ -34,13 +121,15 @@ static void real_time_sleep (int64_t num, int32_t denom);
    corresponding interrupt. */
 void
 timer_init (void) {
-	/* 8254 input frequency divided by TIMER_FREQ, rounded to
-	   nearest. */
-	uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
-	outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
-	outb (0x40, count & 0xff);
-	outb (0x40, count >> 8);
+	pit_program (2, PIT_COUNT);
 	intr_register_ext (0x20, timer_interrupt, "8254 Timer");
+
+	for (int i = 0; i < WHEEL0_SIZE; i++)
+		list_init (&wheel0[i]);
+	for (int l = 0; l < WHEEL_LEVELS; l++)
+		for (int i = 0; i < WHEELN_SIZE; i++)
+			list_init (&wheeln[l][i]);
+	list_init (&hr_sleepers);
 }
 
 /* Calibrates loops_per_tick, used to implement brief delays. */
@@ -66,6 +155,61 @@ timer_calibrate (void) {
 			loops_per_tick |= test_bit;
 
 	printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
+
+	/* Time the TSC, and the LAPIC timer if there is one, over
+	   CAL_TICKS ticks starting at a tick boundary. */
+	bool have_lapic = lapic_init ();
+	uint64_t tsc_start, tsc_end;
+	uint32_t lapic_counts = 0;
+	int64_t start = ticks;
+
+	while (ticks == start)
+		barrier ();
+	start = ticks;
+	tsc_start = rdtsc ();
+	if (have_lapic)
+		lapic_timer_start (UINT32_MAX);
+	while (ticks - start < CAL_TICKS)
+		barrier ();
+	tsc_end = rdtsc ();
+	if (have_lapic) {
+		lapic_counts = UINT32_MAX - lapic_timer_count ();
+		lapic_timer_stop ();
+	}
+
+	enum intr_level old_level = intr_disable ();
+	tsc_hz = (tsc_end - tsc_start) * TIMER_FREQ / CAL_TICKS;
+	tsc_epoch = tsc_end;
+	epoch_ticks = start + CAL_TICKS;
+	intr_set_level (old_level);
+
+	if (have_lapic && lapic_counts > 0) {
+		intr_register_ext (LAPIC_TIMER_VEC, hrtimer_interrupt, "LAPIC Timer");
+		lapic_hz = (uint64_t) lapic_counts * TIMER_FREQ / CAL_TICKS;
+	}
+}
+
+/* Returns nanoseconds since the OS booted, from the TSC once it
+   has been calibrated. */
+int64_t
+timer_now_ns (void) {
+	uint64_t cycles;
+
+	if (tsc_hz == 0)
+		return timer_ticks () * (NSEC_PER_SEC / TIMER_FREQ);
+
+	/* Split the conversion so that the product cannot overflow. */
+	cycles = rdtsc () - tsc_epoch;
+	return epoch_ticks * (NSEC_PER_SEC / TIMER_FREQ)
+		+ cycles / tsc_hz * NSEC_PER_SEC
+		+ cycles % tsc_hz * NSEC_PER_SEC / tsc_hz;
+}
+
+/* Returns the calibrated TSC frequency in Hz, or 0 before
+   timer_calibrate(). */
+uint64_t
+timer_tsc_hz (void) {
+	return tsc_hz;
 }
 
 /* Returns the number of timer ticks since the OS booted. */
@@ -88,11 +232,19 @@ timer_elapsed (int64_t then) {
 /* Suspends execution for approximately TICKS timer ticks. */
 void
 timer_sleep (int64_t ticks) {
+	int64_t start = timer_ticks ();
+	struct thread *cur = thread_current ();
+	enum intr_level old_level;
+
 	ASSERT (intr_get_level () == INTR_ON);
-	if (ticks > 0) {
-		thread_wait(ticks + timer_ticks ());	
-	}
-	
+	if (ticks <= 0)
+		return;
+
+	old_level = intr_disable ();
+	cur->wait_time = start + ticks;
+	wheel_insert (cur);
+	thread_block ();
+	intr_set_level (old_level);
 }
 
 /* Suspends execution for approximately MS milliseconds. */
@@ -119,14 +271,324 @@ timer_print_stats (void) {
 	printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
 }
 
+/* Called by the idle thread, with interrupts off, just before it
+   halts.  In tickless mode, replaces the periodic tick by a
+   one-shot interrupt at the next sleeper's deadline, or as far
+   out as the one-shot timer can count.  The one-shot never runs
+   past a wrap of the wheel's level 0, where sleepers from the
+   upper levels may cascade down and come due, nor past the next
+   delayed work or real-time thread release. */
+void
+timer_idle_enter (void) {
+	int64_t work_due, release_ns, max_ticks;
+	int64_t n;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (!timer_tickless || oneshot)
+		return;
+
+	work_due = workqueue_next_expiry ();
+	release_ns = thread_edf_next_release ();
+	if (release_ns != INT64_MAX && release_ns / NSEC_PER_TICK < work_due)
+		work_due = release_ns / NSEC_PER_TICK;
+	max_ticks = lapic_hz != 0 ? WHEEL0_SIZE : PIT_ONESHOT_MAX_TICKS;
+	for (n = 1; n < max_ticks; n++) {
+		int64_t t = ticks + n;
+
+		if ((t & (WHEEL0_SIZE - 1)) == 0
+				|| !list_empty (&wheel0[t & (WHEEL0_SIZE - 1)])
+				|| t >= work_due)
+			break;
+	}
+	if (n <= 1)
+		return;
+
+	if (lapic_hz != 0) {
+		/* Sub-tick sleepers share the LAPIC timer, so take
+		   whichever deadline comes first. */
+		int64_t due = (ticks + n) * NSEC_PER_TICK;
+		int64_t delta;
+		uint64_t counts;
+
+		if (!list_empty (&hr_sleepers)) {
+			struct thread *t = list_entry (list_front (&hr_sleepers),
+					struct thread, elem);
+			if (t->wait_time < due)
+				due = t->wait_time;
+		}
+		delta = due - timer_now_ns ();
+		if (delta < NSEC_PER_TICK)
+			return;
+		counts = (uint64_t) delta * lapic_hz / NSEC_PER_SEC;
+		if (counts > UINT32_MAX)
+			counts = UINT32_MAX;
+
+		oneshot = oneshot_lapic = true;
+		intr_mask_ext (0x20, true);
+		lapic_timer_start (counts);
+		return;
+	}
+
+	oneshot = true;
+	oneshot_ticks = n;
+	oneshot_counts = n * PIT_COUNT;
+	pit_program (0, oneshot_counts);
+}
+
+/* Called by the idle thread, with interrupts off, when it is
+   about to give up the CPU.  If an interrupt other than the timer
+   woke the CPU from a one-shot wait, reprograms the one-shot to
+   expire right away, or at the next tick boundary on the PIT, so
+   that the timer interrupt catches up on the elapsed ticks as
+   soon as interrupts are back on. */
+void
+timer_idle_exit (void) {
+	uint16_t remaining;
+	unsigned elapsed;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (!oneshot)
+		return;
+
+	if (oneshot_lapic) {
+		lapic_timer_start (1);
+		return;
+	}
+
+	/* A counter at zero, or wrapped past it, has already raised
+	   its interrupt, which will be delivered once interrupts are
+	   back on. */
+	remaining = pit_read ();
+	if (remaining == 0 || remaining > oneshot_counts)
+		return;
+
+	elapsed = oneshot_counts - remaining;
+	oneshot_ticks = elapsed / PIT_COUNT + 1;
+	oneshot_counts = PIT_COUNT - elapsed % PIT_COUNT;
+	pit_program (0, oneshot_counts);
+}
+
 /* Timer interrupt handler. */
 static void
-timer_interrupt (struct intr_frame *args UNUSED) {
+timer_interrupt (struct intr_frame *args) {
+	bool user = (args->cs & 3) == 3;
+
+	if (profile_enabled)
+		profile_sample (args);
+
+	if (oneshot && !oneshot_lapic) {
+		oneshot_end (oneshot_ticks, user);
+		return;
+	}
+
 	ticks++;
-	thread_tick ();
-	enum intr_level old_level = intr_disable();
-	thread_ready (ticks);
-	intr_set_level(old_level);
+	thread_tick (user);
+	wheel_advance ();
+	workqueue_tick (ticks);
+}
+
+/* Ends a tickless one-shot period, in an interrupt handler:
+   restarts the periodic tick and accounts for the ELAPSED ticks
+   that it covered. */
+static void
+oneshot_end (unsigned elapsed, bool user) {
+	ASSERT (oneshot);
+
+	oneshot = false;
+	pit_program (2, PIT_COUNT);
+	if (oneshot_lapic) {
+		oneshot_lapic = false;
+		intr_mask_ext (0x20, false);
+	}
+
+	while (elapsed-- > 0) {
+		ticks++;
+		thread_tick (user);
+	}
+	wheel_advance ();
+	workqueue_tick (ticks);
+}
+
+/* Blocks the running thread for NS nanoseconds, less than a
+   tick, on the LAPIC timer. */
+static void
+hr_sleep (int64_t ns) {
+	struct thread *cur = thread_current ();
+	enum intr_level old_level;
+
+	old_level = intr_disable ();
+	cur->wait_time = timer_now_ns () + ns;
+	list_insert_ordered (&hr_sleepers, &cur->elem, hr_less, NULL);
+	if (list_front (&hr_sleepers) == &cur->elem)
+		hr_arm ();
+	thread_block ();
+	intr_set_level (old_level);
+}
+
+/* Arms the LAPIC timer for the first sub-tick sleeper's
+   deadline, or stops it if there are none.  Interrupts must be
+   off. */
+static void
+hr_arm (void) {
+	struct thread *t;
+	int64_t delta;
+	uint64_t counts;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (list_empty (&hr_sleepers)) {
+		lapic_timer_stop ();
+		return;
+	}
+	t = list_entry (list_front (&hr_sleepers), struct thread, elem);
+	delta = t->wait_time - timer_now_ns ();
+	counts = delta > 0 ? (uint64_t) delta * lapic_hz / NSEC_PER_SEC : 0;
+	if (counts == 0)
+		counts = 1;
+	else if (counts > UINT32_MAX)
+		counts = UINT32_MAX;
+	lapic_timer_start (counts);
+}
+
+/* LAPIC timer interrupt handler.  Wakes every sub-tick sleeper
+   whose deadline has passed and re-arms for the rest. */
+static void
+hrtimer_interrupt (struct intr_frame *args) {
+	int64_t now = timer_now_ns ();
+	int max_priority = thread_current ()->priority;
+	bool preempt = false;
+
+	/* A tickless idle period ends on the LAPIC timer too; the ticks
+	   it skipped are those the TSC clock has seen pass since. */
+	if (oneshot_lapic)
+		oneshot_end (now / NSEC_PER_TICK > ticks
+				? now / NSEC_PER_TICK - ticks : 0, (args->cs & 3) == 3);
+
+	while (!list_empty (&hr_sleepers)) {
+		struct thread *t = list_entry (list_front (&hr_sleepers),
+				struct thread, elem);
+
+		if (t->wait_time > now)
+			break;
+		list_pop_front (&hr_sleepers);
+		thread_unblock (t);
+		if (t->priority > max_priority) {
+			max_priority = t->priority;
+			preempt = true;
+		}
+	}
+	hr_arm ();
+
+	if (preempt)
+		intr_yield_on_return ();
+}
+
+/* Orders sub-tick sleepers by deadline. */
+static bool
+hr_less (const struct list_elem *a, const struct list_elem *b,
+		void *aux UNUSED) {
+	return list_entry (a, struct thread, elem)->wait_time
+		< list_entry (b, struct thread, elem)->wait_time;
+}
+
+/* Programs PIT counter 0 for MODE (2 for periodic rate
+   generation, 0 for one-shot) with initial COUNT. */
+static void
+pit_program (uint8_t mode, uint16_t count) {
+	/* CW: counter 0, LSB then MSB, MODE, binary. */
+	outb (0x43, 0x30 | (mode << 1));
+	outb (0x40, count & 0xff);
+	outb (0x40, count >> 8);
+}
+
+/* Returns the current value of PIT counter 0. */
+static uint16_t
+pit_read (void) {
+	uint8_t lsb, msb;
+
+	outb (0x43, 0x00);    /* CW: counter 0, latch. */
+	lsb = inb (0x40);
+	msb = inb (0x40);
+	return (msb << 8) | lsb;
+}
+
+/* Files sleeping thread T in the timing wheel by its wait_time.
+   A deadline that has already passed goes in the slot processed
+   next, so it still fires.  Interrupts must be off. */
+static void
+wheel_insert (struct thread *t) {
+	int64_t expires = t->wait_time;
+	int64_t delta = expires - wheel_time;
+	struct list *slot;
+	int l;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (delta < 0)
+		slot = &wheel0[wheel_time & (WHEEL0_SIZE - 1)];
+	else if (delta < WHEEL0_SIZE)
+		slot = &wheel0[expires & (WHEEL0_SIZE - 1)];
+	else {
+		/* Beyond the wheel's span, park in the farthest slot;
+		   cascading will refile it from there. */
+		if (delta >= WHEEL_SPAN)
+			expires = wheel_time + WHEEL_SPAN - 1;
+		for (l = 0; l < WHEEL_LEVELS - 1; l++)
+			if (delta < 1LL << (WHEEL0_BITS + (l + 1) * WHEELN_BITS))
+				break;
+		slot = &wheeln[l][(expires >> (WHEEL0_BITS + l * WHEELN_BITS))
+			& (WHEELN_SIZE - 1)];
+	}
+	list_push_back (slot, &t->elem);
+}
+
+/* Refiles every thread in the current slot of upper level LEVEL
+   into the levels below.  Returns the slot's index, which is 0
+   when LEVEL has wrapped around too. */
+static int
+wheel_cascade (int level) {
+	int idx = (wheel_time >> (WHEEL0_BITS + level * WHEELN_BITS))
+		& (WHEELN_SIZE - 1);
+	struct list *slot = &wheeln[level][idx];
+
+	while (!list_empty (slot))
+		wheel_insert (list_entry (list_pop_front (slot), struct thread, elem));
+	return idx;
+}
+
+/* Processes the timing wheel up to the current tick, waking every
+   thread whose deadline has come.  Asks for a preemption if one
+   of them outranks the running thread. */
+static void
+wheel_advance (void) {
+	int max_priority = thread_current ()->priority;
+	bool preempt = false;
+
+	while (wheel_time <= ticks) {
+		int idx = wheel_time & (WHEEL0_SIZE - 1);
+		struct list *slot = &wheel0[idx];
+		int l;
+
+		if (idx == 0)
+			for (l = 0; l < WHEEL_LEVELS && wheel_cascade (l) == 0; l++)
+				continue;
+		wheel_time++;
+
+		while (!list_empty (slot)) {
+			struct thread *t = list_entry (list_pop_front (slot),
+					struct thread, elem);
+			thread_unblock (t);
+			if (t->priority > max_priority) {
+				max_priority = t->priority;
+				preempt = true;
+			}
+		}
+	}
+
+	if (preempt && intr_context ())
+		intr_yield_on_return ();
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -177,6 +639,11 @@ real_time_sleep (int64_t num, int32_t denom) {
 		   timer_sleep() because it will yield the CPU to other
 		   processes. */
 		timer_sleep (ticks);
+	} else if (lapic_hz != 0 && num * (NSEC_PER_SEC / denom) >= HR_SPIN_NS) {
+		/* Long enough to be worth blocking until a LAPIC timer
+		   interrupt at the exact deadline. */
+		ASSERT (NSEC_PER_SEC % denom == 0);
+		hr_sleep (num * (NSEC_PER_SEC / denom));
 	} else {
 		/* Otherwise, use a busy-wait loop for more accurate
 		   sub-tick timing.  We scale the numerator and denominator
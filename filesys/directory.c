@@ -5,6 +5,7 @@
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* A directory. */
 struct dir {
@@ -100,19 +101,24 @@ lookup (const struct dir *dir, const char *name,
 /* Searches DIR for a file with the given NAME
  * and returns true if one exists, false otherwise.
  * On success, sets *INODE to an inode for the file, otherwise to
- * a null pointer.  The caller must close *INODE. */
+ * a null pointer.  The caller must close *INODE.
+ * Lookups in the same directory run in parallel. */
 bool
 dir_lookup (const struct dir *dir, const char *name,
 		struct inode **inode) {
+	struct rwlock *rw;
 	struct dir_entry e;
 
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
+	rw = inode_get_rwlock (dir->inode);
+	rwlock_acquire_read (rw);
 	if (lookup (dir, name, &e, NULL))
 		*inode = inode_open (e.inode_sector);
 	else
 		*inode = NULL;
+	rwlock_release_read (rw);
 
 	return *inode != NULL;
 }
@@ -136,6 +142,8 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
 	if (*name == '\0' || strlen (name) > NAME_MAX)
 		return false;
 
+	rwlock_acquire_write (inode_get_rwlock (dir->inode));
+
 	/* Check that NAME is not in use. */
 	if (lookup (dir, name, NULL, NULL))
 		goto done;
@@ -159,6 +167,7 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
 	success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
 
 done:
+	rwlock_release_write (inode_get_rwlock (dir->inode));
 	return success;
 }
 
@@ -175,6 +184,8 @@ dir_remove (struct dir *dir, const char *name) {
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
+	rwlock_acquire_write (inode_get_rwlock (dir->inode));
+
 	/* Find directory entry. */
 	if (!lookup (dir, name, &e, &ofs))
 		goto done;
@@ -194,6 +205,7 @@ dir_remove (struct dir *dir, const char *name) {
 	success = true;
 
 done:
+	rwlock_release_write (inode_get_rwlock (dir->inode));
 	inode_close (inode);
 	return success;
 }
@@ -203,14 +215,19 @@ done:
  * contains no more entries. */
 bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1]) {
+	struct rwlock *rw = inode_get_rwlock (dir->inode);
 	struct dir_entry e;
+	bool found = false;
 
+	rwlock_acquire_read (rw);
 	while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) {
 		dir->pos += sizeof e;
 		if (e.in_use) {
 			strlcpy (name, e.name, NAME_MAX + 1);
-			return true;
+			found = true;
+			break;
 		}
 	}
-	return false;
+	rwlock_release_read (rw);
+	return found;
 }
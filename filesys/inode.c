@@ -5,7 +5,10 @@
 #include <string.h>
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -33,6 +36,7 @@ struct inode {
 	int open_cnt;                       /* Number of openers. */
 	bool removed;                       /* True if deleted, false otherwise. */
 	int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+	struct rwlock rwlock;               /* For users of the content. */
 	struct inode_disk data;             /* Inode content. */
 };
 
@@ -50,13 +54,34 @@ byte_to_sector (const struct inode *inode, off_t pos) {
 }
 
 /* List of open inodes, so that opening a single inode twice
- * returns the same `struct inode'. */
+ * returns the same `struct inode'.  Searched under a read lock,
+ * since opening an inode that is already open is by far the most
+ * common case; changed only under the write lock. */
 static struct list open_inodes;
+static struct rwlock open_inodes_lock;
+
+static struct inode *find_open_inode (disk_sector_t);
 
 /* Initializes the inode module. */
 void
 inode_init (void) {
 	list_init (&open_inodes);
+	rwlock_init (&open_inodes_lock);
+}
+
+/* Returns the open inode for SECTOR, reopened, or a null pointer
+ * if SECTOR is not open.  OPEN_INODES_LOCK must be held. */
+static struct inode *
+find_open_inode (disk_sector_t sector) {
+	struct list_elem *e;
+
+	for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
+			e = list_next (e)) {
+		struct inode *inode = list_entry (e, struct inode, elem);
+		if (inode->sector == sector)
+			return inode_reopen (inode);
+	}
+	return NULL;
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -101,18 +126,14 @@ inode_create (disk_sector_t sector, off_t length) {
  * Returns a null pointer if memory allocation fails. */
 struct inode *
 inode_open (disk_sector_t sector) {
-	struct list_elem *e;
-	struct inode *inode;
+	struct inode *inode, *open;
 
 	/* Check whether this inode is already open. */
-	for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-			e = list_next (e)) {
-		inode = list_entry (e, struct inode, elem);
-		if (inode->sector == sector) {
-			inode_reopen (inode);
-			return inode; 
-		}
-	}
+	rwlock_acquire_read (&open_inodes_lock);
+	inode = find_open_inode (sector);
+	rwlock_release_read (&open_inodes_lock);
+	if (inode != NULL)
+		return inode;
 
 	/* Allocate memory. */
 	inode = malloc (sizeof *inode);
@@ -120,20 +141,35 @@ inode_open (disk_sector_t sector) {
 		return NULL;
 
 	/* Initialize. */
-	list_push_front (&open_inodes, &inode->elem);
 	inode->sector = sector;
 	inode->open_cnt = 1;
 	inode->deny_write_cnt = 0;
 	inode->removed = false;
+	rwlock_init (&inode->rwlock);
 	disk_read (filesys_disk, inode->sector, &inode->data);
+
+	/* Someone else may have opened it while we read it in. */
+	rwlock_acquire_write (&open_inodes_lock);
+	open = find_open_inode (sector);
+	if (open == NULL)
+		list_push_front (&open_inodes, &inode->elem);
+	rwlock_release_write (&open_inodes_lock);
+	if (open != NULL) {
+		free (inode);
+		inode = open;
+	}
 	return inode;
 }
 
 /* Reopens and returns INODE. */
 struct inode *
 inode_reopen (struct inode *inode) {
-	if (inode != NULL)
+	if (inode != NULL) {
+		/* Readers of the open inode list reopen concurrently. */
+		enum intr_level old_level = intr_disable ();
 		inode->open_cnt++;
+		intr_set_level (old_level);
+	}
 	return inode;
 }
 
@@ -148,15 +184,25 @@ inode_get_inumber (const struct inode *inode) {
  * If INODE was also a removed inode, frees its blocks. */
 void
 inode_close (struct inode *inode) {
+	enum intr_level old_level;
+	bool last;
+
 	/* Ignore null pointer. */
 	if (inode == NULL)
 		return;
 
-	/* Release resources if this was the last opener. */
-	if (--inode->open_cnt == 0) {
-		/* Remove from inode list and release lock. */
+	rwlock_acquire_write (&open_inodes_lock);
+	old_level = intr_disable ();
+	last = --inode->open_cnt == 0;
+	intr_set_level (old_level);
+	if (last) {
+		/* Remove from inode list. */
 		list_remove (&inode->elem);
+	}
+	rwlock_release_write (&open_inodes_lock);
 
+	/* Release resources if this was the last opener. */
+	if (last) {
 		/* Deallocate blocks if removed. */
 		if (inode->removed) {
 			free_map_release (inode->sector, 1);
@@ -183,7 +229,11 @@ off_t
 inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 	uint8_t *buffer = buffer_;
 	off_t bytes_read = 0;
+#if THREAD_STACK_PAGES > 1
+	uint8_t bounce[DISK_SECTOR_SIZE];
+#else
 	uint8_t *bounce = NULL;
+#endif
 
 	while (size > 0) {
 		/* Disk sector to read, starting byte offset within sector. */
@@ -205,12 +255,16 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 			disk_read (filesys_disk, sector_idx, buffer + bytes_read); 
 		} else {
 			/* Read sector into bounce buffer, then partially copy
-			 * into caller's buffer. */
+			 * into caller's buffer.  With a multi-page kernel
+			 * stack the bounce buffer lives there; otherwise it
+			 * comes from the heap. */
+#if THREAD_STACK_PAGES == 1
 			if (bounce == NULL) {
 				bounce = malloc (DISK_SECTOR_SIZE);
 				if (bounce == NULL)
 					break;
 			}
+#endif
 			disk_read (filesys_disk, sector_idx, bounce);
 			memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
 		}
@@ -220,7 +274,9 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 		offset += chunk_size;
 		bytes_read += chunk_size;
 	}
+#if THREAD_STACK_PAGES == 1
 	free (bounce);
+#endif
 
 	return bytes_read;
 }
@@ -235,7 +291,11 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 		off_t offset) {
 	const uint8_t *buffer = buffer_;
 	off_t bytes_written = 0;
+#if THREAD_STACK_PAGES > 1
+	uint8_t bounce[DISK_SECTOR_SIZE];
+#else
 	uint8_t *bounce = NULL;
+#endif
 
 	if (inode->deny_write_cnt)
 		return 0;
@@ -260,11 +320,13 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 			disk_write (filesys_disk, sector_idx, buffer + bytes_written); 
 		} else {
 			/* We need a bounce buffer. */
+#if THREAD_STACK_PAGES == 1
 			if (bounce == NULL) {
 				bounce = malloc (DISK_SECTOR_SIZE);
 				if (bounce == NULL)
 					break;
 			}
+#endif
 
 			/* If the sector contains data before or after the chunk
 			   we're writing, then we need to read in the sector
@@ -282,7 +344,9 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 		offset += chunk_size;
 		bytes_written += chunk_size;
 	}
+#if THREAD_STACK_PAGES == 1
 	free (bounce);
+#endif
 
 	return bytes_written;
 }
@@ -311,3 +375,11 @@ off_t
 inode_length (const struct inode *inode) {
 	return inode->data.length;
 }
+
+/* Returns INODE's reader-writer lock, which the inode module
+ * itself does not take: it is for users that interpret the
+ * inode's content, such as the directory code. */
+struct rwlock *
+inode_get_rwlock (struct inode *inode) {
+	return &inode->rwlock;
+}
@@ -0,0 +1,29 @@
+#ifndef DEVICES_LAPIC_H
+#define DEVICES_LAPIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Interrupt vectors delivered by the local APIC.  Vectors
+   0xf0...0xff are external interrupts acknowledged on the LAPIC
+   rather than on the 8259A PICs. */
+#define LAPIC_VEC_MIN 0xf0
+#define LAPIC_TIMER_VEC 0xf0            /* LAPIC timer. */
+#define LAPIC_SPURIOUS_VEC 0xff         /* Spurious interrupt. */
+
+/* Interprocessor interrupt commands, for lapic_ipi_others(). */
+#define LAPIC_IPI_INIT 0x00004500       /* INIT, level assert. */
+#define LAPIC_IPI_STARTUP 0x00004600    /* Startup; OR in the page number. */
+
+bool lapic_init (void);
+void lapic_init_ap (void);
+bool lapic_present (void);
+uint8_t lapic_id (void);
+void lapic_eoi (void);
+void lapic_ipi_others (uint32_t icr);
+
+void lapic_timer_start (uint32_t count);
+uint32_t lapic_timer_count (void);
+void lapic_timer_stop (void);
+
+#endif /* devices/lapic.h */
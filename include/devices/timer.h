@@ -2,6 +2,7 @@
 #define DEVICES_TIMER_H
 
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
@@ -12,6 +13,8 @@ void timer_calibrate (void);
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
+int64_t timer_now_ns (void);
+uint64_t timer_tsc_hz (void);
 
 void timer_sleep (int64_t ticks);
 void timer_msleep (int64_t milliseconds);
@@ -20,4 +23,8 @@ void timer_nsleep (int64_t nanoseconds);
 
 void timer_print_stats (void);
 
+extern bool timer_tickless;
+void timer_idle_enter (void);
+void timer_idle_exit (void);
+
 #endif /* devices/timer.h */
@@ -95,6 +95,11 @@ struct list {
 	struct list_elem tail;      /* List tail. */
 };
 
+/* Initializer for a list named NAME, for use where list_init()
+   cannot be called early enough. */
+#define LIST_INITIALIZER(NAME) { { NULL, &(NAME).tail }, \
+	                             { &(NAME).head, NULL } }
+
 /* Converts pointer to list element LIST_ELEM into a pointer to
    the structure that LIST_ELEM is embedded inside.  Supply the
    name of the outer structure STRUCT and the member name MEMBER
@@ -0,0 +1,19 @@
+#ifndef __LIB_RUSAGE_H
+#define __LIB_RUSAGE_H
+
+#include <stdint.h>
+
+/* Whose resource usage getrusage() reports. */
+#define RUSAGE_SELF 0           /* The calling process. */
+
+/* CPU usage of a process, as reported by getrusage(). */
+struct rusage {
+	int64_t user_ticks;         /* Timer ticks spent in user mode. */
+	int64_t kernel_ticks;       /* Timer ticks spent in kernel mode. */
+	int64_t voluntary_switches; /* Times it gave up the CPU to block. */
+	int64_t involuntary_switches; /* Times it was preempted or yielded. */
+	int64_t ready_ns;           /* Time ready to run, waiting for the CPU. */
+	int64_t blocked_ns;         /* Time blocked, e.g. sleeping or in I/O. */
+};
+
+#endif /* lib/rusage.h */
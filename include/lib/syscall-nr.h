@@ -36,6 +36,9 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Extra: accounting. */
+	SYS_GETRUSAGE,              /* Report CPU usage. */
 };
 
 #endif /* lib/syscall-nr.h */
@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <debug.h>
 #include <stddef.h>
+#include <rusage.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -38,6 +39,8 @@ void close (int fd);
 
 int dup2(int oldfd, int newfd);
 
+int getrusage (int who, struct rusage *usage);
+
 /* Project 3 and optionally project 4. */
 void *mmap (void *addr, size_t length, int writable, int fd, off_t offset);
 void munmap (void *addr);
@@ -78,4 +81,24 @@ get_fs_disk_write_cnt (void) {
 	return write_cnt;
 }
 
+/* Paging statistics, see enum vm_stat in vm/vm.h.  Returns the
+   statistic for the calling process, or for the whole system if
+   GLOBAL is true. */
+static inline long long
+get_vm_stat (int stat, bool global) {
+	long long value;
+	asm volatile ("int $0x45"
+			: "=a" (value)
+			: "a" ((long long) stat), "d" ((long long) global)
+			: "memory");
+	return value;
+}
+
+/* Prints the calling process's address-space map to the
+   console. */
+static inline void
+dump_vm_map (void) {
+	asm volatile ("int $0x46" ::: "memory");
+}
+
 #endif /* lib/user/syscall.h */
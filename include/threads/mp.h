@@ -0,0 +1,36 @@
+#ifndef THREADS_MP_H
+#define THREADS_MP_H
+
+/* Maximum number of CPUs brought up. */
+#define CPU_MAX 16
+
+/* Physical address the AP start-up trampoline is copied to.  It
+   must be page-aligned and below 1 MB; this page lies between the
+   multiboot info and the loader, which the kernel never reuses. */
+#define MP_TRAMPOLINE 0x8000
+
+#ifndef __ASSEMBLER__
+#include <stdbool.h>
+#include <stdint.h>
+
+struct thread;
+
+/* Per-CPU data. */
+struct cpu {
+	int id;                             /* Index in cpus[]. */
+	uint8_t apic_id;                    /* Local APIC ID. */
+	volatile bool online;               /* Started and running? */
+	struct thread *idle;                /* Idle thread, or NULL. */
+};
+
+extern struct cpu cpus[CPU_MAX];
+extern int cpu_cnt;
+
+/* If true, start the application processors.  Controlled by
+   kernel command-line option "-smp". */
+extern bool mp_enabled;
+
+void mp_init (void);
+#endif
+
+#endif /* threads/mp.h */
@@ -0,0 +1,20 @@
+#ifndef THREADS_SCHED_TRACE_H
+#define THREADS_SCHED_TRACE_H
+
+#include <stdbool.h>
+#include "threads/thread.h"
+
+/* True if scheduler events are being recorded ("-sched-trace"). */
+extern bool sched_trace;
+
+void sched_trace_init (void);
+void sched_trace_create (const struct thread *);
+void sched_trace_switch (const struct thread *prev, const struct thread *next);
+void sched_trace_block (const struct thread *, const void *where);
+void sched_trace_wakeup (const struct thread *);
+void sched_trace_donate (const struct thread *donor,
+		const struct thread *recipient);
+void sched_trace_slice (const struct thread *);
+void sched_trace_dump (void);
+
+#endif /* threads/sched-trace.h */
@@ -0,0 +1,29 @@
+#ifndef THREADS_SPINLOCK_H
+#define THREADS_SPINLOCK_H
+
+#include <stdbool.h>
+#include "threads/interrupt.h"
+
+/* Spin lock.
+
+   Protects data that interrupt handlers, or code on another CPU,
+   may touch, where a sleeping lock cannot be used.  On one CPU,
+   turning interrupts off is enough for mutual exclusion; with
+   several CPUs it is not, so such code takes a spin lock as
+   well, with spin_lock_irqsave().  The holder must not sleep. */
+struct spinlock {
+	volatile int locked;                /* Nonzero while held. */
+};
+
+#define SPINLOCK_INITIALIZER { 0 }
+
+void spin_lock_init (struct spinlock *);
+void spin_lock (struct spinlock *);
+bool spin_trylock (struct spinlock *);
+void spin_unlock (struct spinlock *);
+bool spin_lock_held (const struct spinlock *);
+
+enum intr_level spin_lock_irqsave (struct spinlock *);
+void spin_unlock_irqrestore (struct spinlock *, enum intr_level);
+
+#endif /* threads/spinlock.h */
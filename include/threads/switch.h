@@ -0,0 +1,22 @@
+#ifndef THREADS_SWITCH_H
+#define THREADS_SWITCH_H
+
+#include <stdint.h>
+#include "threads/interrupt.h"
+
+/* Kernel-to-kernel context switches, in switch.S.
+ *
+ * A thread that has been switched away from keeps only its
+ * callee-saved registers, pushed on its own stack, and the
+ * resulting stack pointer.  Everything else is either dead across
+ * the call or, for a thread interrupted in user mode, already
+ * saved in the interrupt frame on its kernel stack.
+ *
+ * thread_switch() saves the running thread's context in *SAVE_RSP
+ * and resumes the thread whose context NEXT_RSP holds.
+ * thread_switch_new() saves the same way but starts a thread that
+ * has never run by returning through its TF with iretq. */
+void thread_switch (uint64_t *save_rsp, uint64_t next_rsp);
+void thread_switch_new (uint64_t *save_rsp, struct intr_frame *tf);
+
+#endif /* threads/switch.h */
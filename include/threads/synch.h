@@ -3,15 +3,41 @@
 
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #define sema2lock(LOCK_ELEM, STRUCT, MEMBER)           \
 	((STRUCT *) ((uint8_t *) &(LOCK_ELEM)->MEMBER     \
 		- offsetof (STRUCT, semaphore.MEMBER)))
 
+struct thread;
+
+/* Element of a wait queue, embedded in struct thread. */
+struct wait_elem {
+	struct wait_elem *child;    /* First child. */
+	struct wait_elem *next;     /* Next sibling. */
+	struct wait_elem *prev;     /* Previous sibling, or parent. */
+	uint64_t seq;               /* Arrival order. */
+	struct wait_queue *queue;   /* Queue it is in, or NULL. */
+};
+
+/* Queue of waiting threads, highest priority first and first
+   come, first served among equals.  A pairing heap, so pushing
+   is O(1) and popping, or moving a thread whose priority changed,
+   is O(log n) amortized.  Accessed with interrupts off. */
+struct wait_queue {
+	struct wait_elem *root;     /* Front of the queue, or NULL. */
+};
+
+void wait_queue_init (struct wait_queue *);
+bool wait_queue_empty (const struct wait_queue *);
+void wait_queue_push (struct wait_queue *, struct thread *);
+struct thread *wait_queue_pop (struct wait_queue *);
+void wait_queue_requeue (struct thread *);
+
 /* A counting semaphore. */
 struct semaphore {
 	unsigned value;             /* Current value. */
-	struct list waiters;        /* List of waiting threads. */
+	struct wait_queue waiters;  /* Waiting threads. */
 };
 
 void sema_init (struct semaphore *, unsigned value);
@@ -24,17 +50,22 @@ void sema_self_test (void);
 struct lock {
 	struct thread *holder;      /* Thread holding lock (for debugging). */
 	struct semaphore semaphore; /* Binary semaphore controlling access. */
+	struct list_elem elem;      /* Element in holder's held_locks. */
+	struct lock_stat *stat;     /* Contention statistics. */
 };
 
 void lock_init (struct lock *);
+void lock_init_named (struct lock *, const char *name);
 void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
+void lock_stat_init (void);
+void lock_print_stats (void);
 
 /* Condition variable. */
 struct condition {
-	struct list waiters;        /* List of waiting threads. */
+	struct wait_queue waiters;  /* Waiting threads. */
 };
 
 void cond_init (struct condition *);
@@ -42,11 +73,28 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
-void donate(struct lock *);
-void donate_remove(struct thread *, struct lock*);
+/* Reader-writer lock.  Any number of readers, or one writer, may
+   hold it at once.  Writers are preferred: once a writer is
+   waiting, new readers wait behind it.  A writer holds LOCK from
+   the time it starts waiting until it releases, so threads
+   blocked behind it donate their priority to it as usual. */
+struct rwlock {
+	struct lock lock;           /* Held by the writer, if any. */
+	unsigned readers;           /* Number of readers holding it. */
+	bool writer_waiting;        /* Writer waiting for readers to leave? */
+	struct semaphore drained;   /* Upped by the last reader out. */
+};
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+bool rwlock_try_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+bool rwlock_try_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_held_for_write (const struct rwlock *);
 
-bool
-cmp_prior_elem(const struct list_elem *a, const struct list_elem *b, void *aux);
+void donate_refresh (struct thread *);
 
 /* Optimization barrier.
  *
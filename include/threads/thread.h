@@ -3,8 +3,12 @@
 
 #include <debug.h>
 #include <list.h>
+#include <rbtree.h>
 #include <stdint.h>
+#include "threads/fixed-point.h"
 #include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
 #ifdef VM
 #include "vm/vm.h"
 #endif
@@ -28,13 +32,34 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
+/* Thread niceness, for the MLFQS scheduler. */
+#define NICE_MIN -20                    /* Most favorable. */
+#define NICE_DEFAULT 0                  /* Default niceness. */
+#define NICE_MAX 20                     /* Least favorable. */
+
+/* Pages in each thread's block: 1 (the default), 2 or 4, set at
+ * build time with e.g. "make STACK_DEFINES=-DTHREAD_STACK_PAGES=4"
+ * after a "make clean".
+ * Larger blocks are mapped from a dedicated virtual region,
+ * each with an unmapped guard page below it, so that a stack
+ * overflow faults instead of running into another thread. */
+#ifndef THREAD_STACK_PAGES
+#define THREAD_STACK_PAGES 1
+#endif
+#if THREAD_STACK_PAGES != 1 && THREAD_STACK_PAGES != 2 \
+	&& THREAD_STACK_PAGES != 4
+#error THREAD_STACK_PAGES must be 1, 2 or 4.
+#endif
+#define THREAD_STACK_SIZE (THREAD_STACK_PAGES * PGSIZE)
+
 /* A kernel thread or user process.
  *
- * Each thread structure is stored in its own 4 kB page.  The
- * thread structure itself sits at the very bottom of the page
- * (at offset 0).  The rest of the page is reserved for the
+ * Each thread structure is stored in its own block of
+ * THREAD_STACK_SIZE bytes, 4 kB unless configured otherwise.
+ * The thread structure itself sits at the very bottom of the
+ * block (at offset 0).  The rest of the block is reserved for the
  * thread's kernel stack, which grows downward from the top of
- * the page (at offset 4 kB).  Here's an illustration:
+ * the block.  Here's an illustration for a 4 kB block:
  *
  *      4 kB +---------------------------------+
  *           |          kernel stack           |
@@ -72,7 +97,7 @@ typedef int tid_t;
  *       state.  Thus, kernel functions should not allocate large
  *       structures or arrays as non-static local variables.  Use
  *       dynamic allocation with malloc() or palloc_get_page()
- *       instead.
+ *       instead, unless THREAD_STACK_PAGES > 1 leaves room.
  *
  * The first symptom of either of these problems will probably be
  * an assertion failure in thread_current(), which checks that
@@ -80,11 +105,13 @@ typedef int tid_t;
  * set to THREAD_MAGIC.  Stack overflow will normally change this
  * value, triggering the assertion. */
 /* The `elem' member has a dual purpose.  It can be an element in
- * the run queue (thread.c), or it can be an element in a
- * semaphore wait list (synch.c).  It can be used these two ways
+ * the run queue (thread.c), or it can be an element in the
+ * sleepers' timing wheel (timer.c).  It can be used these ways
  * only because they are mutually exclusive: only a thread in the
  * ready state is on the run queue, whereas only a thread in the
- * blocked state is on a semaphore wait list. */
+ * blocked state is in the timing wheel.  A thread blocked on a
+ * semaphore or condition variable is in its wait queue through
+ * `wait_elem' instead. */
 struct thread {
 	/* Owned by thread.c. */
 	tid_t tid;                          /* Thread identifier. */
@@ -94,12 +121,46 @@ struct thread {
 
 	/* Shared between thread.c and synch.c. */
 	struct list_elem elem;              /* List element. */
-	int64_t wait_time; /* record wait_time */
-
-	struct list_elem prior_elem;
-	struct list prior_his;
-	struct lock *lock;
-	int org_prior;
+	int64_t wait_time;                  /* Wakeup tick, or ns for sub-tick sleeps. */
+	struct wait_elem wait_elem;         /* Wait queue element. */
+
+	/* Priority donation, owned by synch.c. */
+	struct list held_locks;             /* Locks held. */
+	struct lock *lock;                  /* Lock waited for, if any. */
+	int org_prior;                      /* Priority without donations. */
+
+	/* MLFQS state, owned by thread.c. */
+	int nice;                           /* Niceness. */
+	fixed_t recent_cpu;                 /* Recent CPU usage. */
+	struct list_elem allelem;           /* List element for all threads. */
+	struct list_elem dirty_elem;        /* Element in dirty list. */
+	bool mlfqs_dirty;                   /* Priority needs recomputing? */
+
+	/* CFS state, owned by thread.c. */
+	struct rb_elem cfs_elem;            /* Element in the CFS run queue. */
+	uint64_t vruntime;                  /* Weighted ns run. */
+	int64_t exec_start;                 /* Time vruntime was last charged. */
+	int64_t slice_exec;                 /* ns run since switched in. */
+
+	/* EDF real-time state, owned by thread.c. */
+	bool edf;                           /* In the real-time class? */
+	struct rb_elem edf_elem;            /* Element in the EDF run queue. */
+	int64_t edf_runtime;                /* Budget per period, ns. */
+	int64_t edf_rel_deadline;           /* Deadline after release, ns. */
+	int64_t edf_period;                 /* Period, ns. */
+	int64_t edf_deadline;               /* Current absolute deadline. */
+	int64_t edf_budget;                 /* Budget left, ns. */
+	int64_t edf_charged;                /* Time budget was last charged. */
+	int64_t edf_release;                /* Next release, while throttled. */
+
+	/* CPU accounting, owned by thread.c. */
+	int64_t cpu_user_ticks;             /* Ticks spent in user mode. */
+	int64_t cpu_kernel_ticks;           /* Ticks spent in kernel mode. */
+	int64_t nvcsw;                      /* Switches away to block. */
+	int64_t nivcsw;                     /* Switches away while ready. */
+	uint64_t ready_cycles;              /* TSC cycles spent ready. */
+	uint64_t blocked_cycles;            /* TSC cycles spent blocked. */
+	uint64_t state_tsc;                 /* TSC at the last status change. */
 
 #ifdef USERPROG
 	/* Owned by userprog/process.c. */
@@ -111,7 +172,8 @@ struct thread {
 #endif
 
 	/* Owned by thread.c. */
-	struct intr_frame tf;               /* Information for switching */
+	struct intr_frame tf;               /* Initial context, for first run. */
+	uint64_t switch_rsp;                /* Saved stack pointer, or 0. */
 	unsigned magic;                     /* Detects stack overflow. */
 };
 
@@ -120,12 +182,19 @@ struct thread {
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* If true, use the completely fair scheduler instead of strict
+   priorities.  Controlled by kernel command-line option "-cfs". */
+extern bool thread_cfs;
+
 void thread_init (void);
 void thread_start (void);
 
-void thread_tick (void);
+void thread_tick (bool user);
 void thread_print_stats (void);
 
+struct rusage;
+void thread_get_rusage (const struct thread *, struct rusage *);
+
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
 
@@ -138,16 +207,22 @@ const char *thread_name (void);
 
 void thread_exit (void) NO_RETURN;
 void thread_yield (void);
+bool thread_cache_trim (void);
+bool thread_stack_guard_hit (const void *, tid_t *, const char **name);
 
 int thread_get_priority (void);
 void thread_set_priority (int);
+void thread_change_priority (struct thread *, int);
 
 int thread_get_nice (void);
 void thread_set_nice (int);
 int thread_get_recent_cpu (void);
 int thread_get_load_avg (void);
-void thread_wait(int64_t ticks);
-void thread_ready(int64_t ticks);
+
+bool thread_set_deadline (int64_t runtime, int64_t deadline, int64_t period);
+void thread_clear_deadline (void);
+void thread_yield_period (void);
+int64_t thread_edf_next_release (void);
 
 void do_iret (struct intr_frame *tf);
 bool
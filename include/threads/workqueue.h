@@ -0,0 +1,47 @@
+#ifndef THREADS_WORKQUEUE_H
+#define THREADS_WORKQUEUE_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* A function to run later, in a worker thread. */
+typedef void work_func (void *aux);
+
+/* States of a work item. */
+enum work_state {
+	WORK_IDLE,          /* Not queued: may be queued. */
+	WORK_DELAYED,       /* Waiting for its timer to expire. */
+	WORK_QUEUED         /* Waiting for a worker. */
+};
+
+/* A work item: a call of FUNC (AUX) to be made by a workqueue's
+   worker thread.  Usually embedded in the structure that AUX
+   points to.  An item may be queued again as soon as its function
+   starts running, including by that function itself. */
+struct work {
+	struct list_elem elem;      /* Element in a pending or delayed list. */
+	work_func *func;            /* Function to call. */
+	void *aux;                  /* Its argument. */
+	enum work_state state;      /* Where ELEM is. */
+	struct workqueue *wq;       /* Queue it was last put on. */
+	int64_t expires;            /* Due tick, while delayed. */
+};
+
+/* Shared queue for work that needs no dedicated workers. */
+extern struct workqueue *system_wq;
+
+void workqueue_init (void);
+struct workqueue *workqueue_create (const char *name, int priority,
+		int worker_cnt);
+
+void work_init (struct work *, work_func *, void *aux);
+bool queue_work (struct workqueue *, struct work *);
+bool queue_delayed_work (struct workqueue *, struct work *, int64_t ticks);
+bool cancel_work (struct work *);
+void workqueue_flush (struct workqueue *);
+
+void workqueue_tick (int64_t now);
+int64_t workqueue_next_expiry (void);
+
+#endif /* threads/workqueue.h */
@@ -1,13 +1,21 @@
 #ifndef VM_ANON_H
 #define VM_ANON_H
+#include <stddef.h>
 #include "vm/vm.h"
 struct page;
 enum vm_type;
 
 struct anon_page {
+	struct swap_dev *dev;       /* Device holding the page, or NULL. */
+	size_t slot;                /* Page-sized slot within DEV. */
 };
 
+/* Also swap to the scratch disk (hd1:0), once the swap disk is
+ * full.  Set by -swap-scratch. */
+extern bool swap_scratch;
+
 void vm_anon_init (void);
+void swap_scratch_attach (void);
 bool anon_initializer (struct page *page, enum vm_type type, void *kva);
 
 #endif
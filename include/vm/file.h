@@ -7,6 +7,18 @@ struct page;
 enum vm_type;
 
 struct file_page {
+	struct file *file;      /* Backing file. */
+	off_t offset;           /* Offset of the page within FILE. */
+	size_t read_bytes;      /* Bytes of FILE in the page; rest is zero. */
+};
+
+/* The aux of every pending VM_FILE page: where its contents will
+ * come from.  file_backed_initializer() copies it into the
+ * page's struct file_page when the page is first touched. */
+struct file_load_aux {
+	struct file *file;      /* Backing file. */
+	off_t offset;           /* Offset of the page within FILE. */
+	size_t read_bytes;      /* Bytes of FILE in the page; rest is zero. */
 };
 
 void vm_file_init (void);
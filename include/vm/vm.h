@@ -1,7 +1,10 @@
 #ifndef VM_VM_H
 #define VM_VM_H
 #include <stdbool.h>
+#include <stdint.h>
+#include <hash.h>
 #include "threads/palloc.h"
+#include "threads/synch.h"
 
 enum vm_type {
 	/* page not initialized */
@@ -24,6 +27,37 @@ enum vm_type {
 	VM_MARKER_END = (1 << 31),
 };
 
+/* Marks pages that belong to the user stack. */
+#define VM_STACK VM_MARKER_0
+
+/* What a page fault had to do, for statistics. */
+enum vm_fault_cause {
+	VM_FAULT_LAZY,      /* First touch of a lazily loaded page. */
+	VM_FAULT_ZERO,      /* First touch of an anonymous zero page. */
+	VM_FAULT_SWAP_IN,   /* Anonymous page read back from swap. */
+	VM_FAULT_FILE_IN,   /* File-backed page read back from its file. */
+	VM_FAULT_COW,       /* Write to a copy-on-write page. */
+	VM_FAULT_STACK,     /* Stack growth. */
+	VM_FAULT_WP,        /* Write to a write-protected page. */
+	VM_FAULT_INVALID,   /* Unmapped address that is not stack growth. */
+	VM_FAULT_CAUSE_CNT
+};
+
+/* Statistics that can be read with the int 0x45 inspect
+ * interrupt.  Indices below VM_FAULT_CAUSE_CNT are the fault
+ * counts by cause. */
+enum vm_stat {
+	VM_STAT_FAULTS = VM_FAULT_CAUSE_CNT, /* All faults. */
+	VM_STAT_EVICTIONS,                   /* Frames evicted. */
+	VM_STAT_SWAP_INS,                    /* Pages read from swap. */
+	VM_STAT_SWAP_OUTS,                   /* Pages written to swap. */
+	VM_STAT_LATENCY = 16                 /* 16 + K: faults that took
+	                                        [2^K, 2^(K+1)) TSC cycles. */
+};
+
+/* Number of log2 buckets in the fault latency histogram. */
+#define VM_FAULT_LAT_BUCKETS 40
+
 #include "vm/uninit.h"
 #include "vm/anon.h"
 #include "vm/file.h"
@@ -46,6 +80,9 @@ struct page {
 	struct frame *frame;   /* Back reference for frame */
 
 	/* Your implementation */
+	struct hash_elem spt_elem;  /* Element in the owner's SPT. */
+	bool writable;         /* Mapped writable? */
+	bool is_stack;         /* Part of the user stack? */
 
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
@@ -85,6 +122,23 @@ struct page_operations {
  * We don't want to force you to obey any specific design for this struct.
  * All designs up to you for this. */
 struct supplemental_page_table {
+	/* All pages, keyed by va.  Only the owning thread adds or
+	 * removes pages, so it may use a page it looked up for as long
+	 * as it likes.  Other threads, such as the evictor, must hold
+	 * LOCK for reading across their use of any page they find. */
+	struct hash pages;
+	struct rwlock lock;    /* Orders the owner's changes to PAGES
+	                          against other threads' reads. */
+	bool live;             /* Initialized and not yet killed?  Plain
+	                          kernel threads never initialize it. */
+
+	/* Page faults taken by this process, by cause.  Starts out
+	 * zeroed with the thread and survives exec. */
+	unsigned long fault_cnt[VM_FAULT_CAUSE_CNT];
+
+	/* User rsp at the last system call, so that a fault the kernel
+	 * takes on a user address can tell stack growth. */
+	uintptr_t user_rsp;
 };
 
 #include "threads/thread.h"
@@ -92,10 +146,14 @@ void supplemental_page_table_init (struct supplemental_page_table *spt);
 bool supplemental_page_table_copy (struct supplemental_page_table *dst,
 		struct supplemental_page_table *src);
 void supplemental_page_table_kill (struct supplemental_page_table *spt);
+void supplemental_page_table_move (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src);
 struct page *spt_find_page (struct supplemental_page_table *spt,
 		void *va);
 bool spt_insert_page (struct supplemental_page_table *spt, struct page *page);
 void spt_remove_page (struct supplemental_page_table *spt, struct page *page);
+void spt_unmap_files (struct supplemental_page_table *spt);
+void spt_dump (struct supplemental_page_table *spt);
 
 void vm_init (void);
 bool vm_try_handle_fault (struct intr_frame *f, void *addr, bool user,
@@ -109,4 +167,9 @@ void vm_dealloc_page (struct page *page);
 bool vm_claim_page (void *va);
 enum vm_type page_get_type (struct page *page);
 
+void vm_stat_fault (enum vm_fault_cause, uint64_t cycles);
+void vm_stat_swap (bool out);
+uint64_t vm_stat_get (int stat, bool global);
+void vm_print_stats (void);
+
 #endif  /* VM_VM_H */
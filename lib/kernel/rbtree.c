@@ -0,0 +1,322 @@
+#include "rbtree.h"
+#include "../debug.h"
+
+/* Red-black tree, after [CLRS] chapter 13, with null pointers
+   for the leaves, which count as black.
+
+   Invariants:
+     1. The root is black.
+     2. A red element has no red child.
+     3. Every path from an element down to a leaf passes the same
+        number of black elements.
+   Together they keep the height within 2 log2 (n + 1). */
+
+static void rotate_left (struct rb_tree *, struct rb_elem *);
+static void rotate_right (struct rb_tree *, struct rb_elem *);
+static void insert_fixup (struct rb_tree *, struct rb_elem *);
+static void remove_fixup (struct rb_tree *, struct rb_elem *,
+		struct rb_elem *parent);
+
+/* Returns true if E is red.  Null leaves are black. */
+static inline bool
+is_red (const struct rb_elem *e) {
+	return e != NULL && e->red;
+}
+
+/* Initializes TREE as an empty tree ordered by LESS, given
+   auxiliary data AUX. */
+void
+rb_init (struct rb_tree *tree, rb_less_func *less, void *aux) {
+	ASSERT (tree != NULL);
+	ASSERT (less != NULL);
+
+	tree->root = NULL;
+	tree->min = NULL;
+	tree->elem_cnt = 0;
+	tree->less = less;
+	tree->aux = aux;
+}
+
+/* Inserts E into TREE, after any elements equal to it. */
+void
+rb_insert (struct rb_tree *tree, struct rb_elem *e) {
+	struct rb_elem *parent = NULL;
+	struct rb_elem **link = &tree->root;
+	bool leftmost = true;
+
+	ASSERT (tree != NULL);
+	ASSERT (e != NULL);
+
+	while (*link != NULL) {
+		parent = *link;
+		if (tree->less (e, parent, tree->aux))
+			link = &parent->left;
+		else {
+			link = &parent->right;
+			leftmost = false;
+		}
+	}
+
+	e->parent = parent;
+	e->left = e->right = NULL;
+	e->red = true;
+	*link = e;
+	if (leftmost)
+		tree->min = e;
+	tree->elem_cnt++;
+
+	insert_fixup (tree, e);
+}
+
+/* Removes E, which must be in TREE, from TREE. */
+void
+rb_remove (struct rb_tree *tree, struct rb_elem *e) {
+	struct rb_elem *child, *parent;
+	bool was_red;
+
+	ASSERT (tree != NULL);
+	ASSERT (e != NULL);
+	ASSERT (tree->elem_cnt > 0);
+
+	if (tree->min == e)
+		tree->min = rb_next (e);
+
+	if (e->left == NULL || e->right == NULL) {
+		/* At most one child: splice E out. */
+		child = e->left != NULL ? e->left : e->right;
+		parent = e->parent;
+		was_red = e->red;
+		if (child != NULL)
+			child->parent = parent;
+		if (parent == NULL)
+			tree->root = child;
+		else if (parent->left == e)
+			parent->left = child;
+		else
+			parent->right = child;
+	} else {
+		/* Two children: move E's successor S, which has no left
+		   child, into E's place, taking E's color. */
+		struct rb_elem *s = e->right;
+
+		while (s->left != NULL)
+			s = s->left;
+		child = s->right;
+		was_red = s->red;
+
+		if (s->parent == e)
+			parent = s;
+		else {
+			parent = s->parent;
+			parent->left = child;
+			if (child != NULL)
+				child->parent = parent;
+			s->right = e->right;
+			s->right->parent = s;
+		}
+		s->left = e->left;
+		s->left->parent = s;
+		s->parent = e->parent;
+		s->red = e->red;
+		if (e->parent == NULL)
+			tree->root = s;
+		else if (e->parent->left == e)
+			e->parent->left = s;
+		else
+			e->parent->right = s;
+	}
+	tree->elem_cnt--;
+
+	if (!was_red)
+		remove_fixup (tree, child, parent);
+}
+
+/* Returns TREE's least element, or a null pointer if TREE is
+   empty. */
+struct rb_elem *
+rb_min (const struct rb_tree *tree) {
+	ASSERT (tree != NULL);
+	return tree->min;
+}
+
+/* Returns the element following E in its tree, or a null pointer
+   if E is the greatest. */
+struct rb_elem *
+rb_next (struct rb_elem *e) {
+	ASSERT (e != NULL);
+
+	if (e->right != NULL) {
+		e = e->right;
+		while (e->left != NULL)
+			e = e->left;
+		return e;
+	}
+	while (e->parent != NULL && e->parent->right == e)
+		e = e->parent;
+	return e->parent;
+}
+
+/* Returns the number of elements in TREE. */
+size_t
+rb_size (const struct rb_tree *tree) {
+	ASSERT (tree != NULL);
+	return tree->elem_cnt;
+}
+
+/* Returns true if TREE is empty. */
+bool
+rb_empty (const struct rb_tree *tree) {
+	ASSERT (tree != NULL);
+	return tree->root == NULL;
+}
+
+/* Makes X's right child take X's place, with X as its left
+   child. */
+static void
+rotate_left (struct rb_tree *tree, struct rb_elem *x) {
+	struct rb_elem *y = x->right;
+
+	x->right = y->left;
+	if (y->left != NULL)
+		y->left->parent = x;
+	y->parent = x->parent;
+	if (x->parent == NULL)
+		tree->root = y;
+	else if (x->parent->left == x)
+		x->parent->left = y;
+	else
+		x->parent->right = y;
+	y->left = x;
+	x->parent = y;
+}
+
+/* Makes X's left child take X's place, with X as its right
+   child. */
+static void
+rotate_right (struct rb_tree *tree, struct rb_elem *x) {
+	struct rb_elem *y = x->left;
+
+	x->left = y->right;
+	if (y->right != NULL)
+		y->right->parent = x;
+	y->parent = x->parent;
+	if (x->parent == NULL)
+		tree->root = y;
+	else if (x->parent->right == x)
+		x->parent->right = y;
+	else
+		x->parent->left = y;
+	y->right = x;
+	x->parent = y;
+}
+
+/* Restores the invariants after inserting red element E. */
+static void
+insert_fixup (struct rb_tree *tree, struct rb_elem *e) {
+	while (is_red (e->parent)) {
+		struct rb_elem *p = e->parent;
+		struct rb_elem *g = p->parent;
+
+		if (p == g->left) {
+			struct rb_elem *uncle = g->right;
+
+			if (is_red (uncle)) {
+				p->red = uncle->red = false;
+				g->red = true;
+				e = g;
+				continue;
+			}
+			if (e == p->right) {
+				rotate_left (tree, p);
+				e = p;
+				p = e->parent;
+			}
+			p->red = false;
+			g->red = true;
+			rotate_right (tree, g);
+		} else {
+			struct rb_elem *uncle = g->left;
+
+			if (is_red (uncle)) {
+				p->red = uncle->red = false;
+				g->red = true;
+				e = g;
+				continue;
+			}
+			if (e == p->left) {
+				rotate_right (tree, p);
+				e = p;
+				p = e->parent;
+			}
+			p->red = false;
+			g->red = true;
+			rotate_left (tree, g);
+		}
+	}
+	tree->root->red = false;
+}
+
+/* Restores the invariants after removing a black element, whose
+   place is now held by X, possibly a null leaf, under PARENT.
+   Paths through X are one black element short. */
+static void
+remove_fixup (struct rb_tree *tree, struct rb_elem *x,
+		struct rb_elem *parent) {
+	while (x != tree->root && !is_red (x)) {
+		if (x == parent->left) {
+			struct rb_elem *w = parent->right;
+
+			if (is_red (w)) {
+				w->red = false;
+				parent->red = true;
+				rotate_left (tree, parent);
+				w = parent->right;
+			}
+			if (!is_red (w->left) && !is_red (w->right)) {
+				w->red = true;
+				x = parent;
+				parent = x->parent;
+			} else {
+				if (!is_red (w->right)) {
+					w->left->red = false;
+					w->red = true;
+					rotate_right (tree, w);
+					w = parent->right;
+				}
+				w->red = parent->red;
+				parent->red = false;
+				w->right->red = false;
+				rotate_left (tree, parent);
+				x = tree->root;
+			}
+		} else {
+			struct rb_elem *w = parent->left;
+
+			if (is_red (w)) {
+				w->red = false;
+				parent->red = true;
+				rotate_right (tree, parent);
+				w = parent->left;
+			}
+			if (!is_red (w->left) && !is_red (w->right)) {
+				w->red = true;
+				x = parent;
+				parent = x->parent;
+			} else {
+				if (!is_red (w->left)) {
+					w->right->red = false;
+					w->red = true;
+					rotate_left (tree, w);
+					w = parent->left;
+				}
+				w->red = parent->red;
+				parent->red = false;
+				w->left->red = false;
+				rotate_right (tree, parent);
+				x = tree->root;
+			}
+		}
+	}
+	if (x != NULL)
+		x->red = false;
+}
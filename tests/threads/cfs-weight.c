@@ -0,0 +1,73 @@
+/* Checks that the completely fair scheduler divides the CPU
+   between competing threads in proportion to their weights.
+
+   Two threads spin for two seconds, timing how long they run.
+   The "heavy" thread's priority gives it weight 3121 against the
+   "light" thread's 1024, the default, so it should get about 75%
+   of the time the two share. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Weighs as nice -5. */
+#define PRI_HEAVY (PRI_DEFAULT + 9)
+
+struct spinner 
+  {
+    int64_t run_ns;             /* Time spent running. */
+    struct semaphore done;      /* Upped when the spinner stops. */
+  };
+
+static thread_func spin_thread;
+static volatile bool stop;
+
+void
+test_cfs_weight (void) 
+{
+  struct spinner heavy, light;
+  int64_t share;
+
+  ASSERT (thread_cfs);
+
+  heavy.run_ns = light.run_ns = 0;
+  sema_init (&heavy.done, 0);
+  sema_init (&light.done, 0);
+  thread_create ("heavy", PRI_HEAVY, spin_thread, &heavy);
+  thread_create ("light", PRI_DEFAULT, spin_thread, &light);
+
+  msg ("spinning for 2 seconds...");
+  timer_sleep (2 * TIMER_FREQ);
+  stop = true;
+  sema_down (&heavy.done);
+  sema_down (&light.done);
+
+  if (heavy.run_ns + light.run_ns == 0)
+    fail ("neither thread ran");
+  share = heavy.run_ns * 100 / (heavy.run_ns + light.run_ns);
+  if (share < 65 || share > 85)
+    fail ("heavy thread got %"PRId64"%% of the CPU, not about 75%%",
+          share);
+  msg ("heavy thread got about 75% of the CPU");
+}
+
+static void
+spin_thread (void *s_) 
+{
+  struct spinner *s = s_;
+  int64_t last = timer_now_ns (), now;
+
+  while (!stop)
+    {
+      /* Longer gaps are time that another thread ran. */
+      now = timer_now_ns ();
+      if (now - last < 1000000)
+        s->run_ns += now - last;
+      last = now;
+    }
+  sema_up (&s->done);
+}
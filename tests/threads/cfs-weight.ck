@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(cfs-weight) begin
+(cfs-weight) spinning for 2 seconds...
+(cfs-weight) heavy thread got about 75% of the CPU
+(cfs-weight) end
+EOF
+pass;
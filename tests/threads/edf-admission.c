@@ -0,0 +1,68 @@
+/* Checks that thread_set_deadline() rejects invalid parameters
+   and admits real-time threads only while the bandwidth they
+   reserve in total stays within the scheduler's limit.
+
+   The main thread reserves half the CPU.  A second thread may
+   then reserve 40% but not another half.  Once it has released
+   its share, the main thread may grow its own reservation to
+   90%, which replaces its half rather than adding to it, but
+   not to 96%, which would leave too little for everyone else. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define MS(X) ((int64_t) (X) * 1000000)
+
+static thread_func second_thread;
+
+static void
+check (bool admitted, bool expected, const char *what) 
+{
+  if (admitted != expected)
+    fail ("%s %s", what, admitted ? "admitted" : "rejected");
+  msg ("%s %s", what, admitted ? "admitted" : "rejected");
+}
+
+void
+test_edf_admission (void) 
+{
+  struct semaphore done;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  check (thread_set_deadline (MS (20), MS (10), MS (100)), false,
+         "runtime beyond deadline");
+  check (thread_set_deadline (MS (20), MS (200), MS (100)), false,
+         "deadline beyond period");
+  check (thread_set_deadline (0, MS (100), MS (100)), false,
+         "zero runtime");
+  check (thread_set_deadline (MS (50), MS (100), MS (100)), true,
+         "50%");
+
+  sema_init (&done, 0);
+  thread_create ("second", PRI_DEFAULT, second_thread, &done);
+  sema_down (&done);
+
+  check (thread_set_deadline (MS (90), MS (100), MS (100)), true,
+         "90% in place of 50%");
+  check (thread_set_deadline (MS (96), MS (100), MS (100)), false,
+         "96%");
+  thread_clear_deadline ();
+}
+
+static void
+second_thread (void *done_) 
+{
+  struct semaphore *done = done_;
+
+  check (thread_set_deadline (MS (50), MS (100), MS (100)), false,
+         "second 50%");
+  check (thread_set_deadline (MS (40), MS (100), MS (100)), true,
+         "40%");
+  thread_clear_deadline ();
+  sema_up (done);
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(edf-admission) begin
+(edf-admission) runtime beyond deadline rejected
+(edf-admission) deadline beyond period rejected
+(edf-admission) zero runtime rejected
+(edf-admission) 50% admitted
+(edf-admission) second 50% rejected
+(edf-admission) 40% admitted
+(edf-admission) 90% in place of 50% admitted
+(edf-admission) 96% rejected
+(edf-admission) end
+EOF
+pass;
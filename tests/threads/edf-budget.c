@@ -0,0 +1,79 @@
+/* Checks that a periodic real-time thread receives its full
+   runtime in each of several periods, even with a CPU-bound
+   thread competing for the CPU.
+
+   The main thread reserves 30 ms of every 100 ms and spins,
+   timing itself.  Gaps in its clock of more than a quarter
+   period mean that it was throttled, which ends a period.  Each
+   period's run time must come to the budget, give or take the
+   timer ticks at which the budget is enforced. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define MS(X) ((int64_t) (X) * 1000000)
+
+#define RUNTIME MS (30)
+#define PERIOD MS (100)
+#define PERIODS 5
+
+static thread_func hog_thread;
+static volatile bool done;
+static struct semaphore hog_done;
+
+void
+test_edf_budget (void) 
+{
+  int64_t ran[PERIODS];
+  int64_t run_ns = 0, last, now;
+  int i = 0;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&hog_done, 0);
+  thread_create ("hog", PRI_DEFAULT, hog_thread, NULL);
+
+  if (!thread_set_deadline (RUNTIME, PERIOD, PERIOD))
+    fail ("thread_set_deadline rejected %d%% of the CPU",
+          (int) (RUNTIME * 100 / PERIOD));
+
+  last = timer_now_ns ();
+  while (i < PERIODS) 
+    {
+      now = timer_now_ns ();
+      if (now - last > PERIOD / 4)
+        {
+          ran[i++] = run_ns;
+          run_ns = 0;
+        }
+      else if (now - last < MS (1))
+        run_ns += now - last;
+      last = now;
+    }
+
+  thread_clear_deadline ();
+  done = true;
+  sema_down (&hog_done);
+
+  for (i = 0; i < PERIODS; i++)
+    if (ran[i] < RUNTIME - RUNTIME / 10
+        || ran[i] > RUNTIME + 2 * MS (1000 / TIMER_FREQ))
+      fail ("period %d: ran %"PRId64" us of a %"PRId64" us budget",
+            i, ran[i] / 1000, RUNTIME / 1000);
+    else
+      msg ("period %d: full budget", i);
+}
+
+static void
+hog_thread (void *aux UNUSED) 
+{
+  while (!done)
+    continue;
+  sema_up (&hog_done);
+}
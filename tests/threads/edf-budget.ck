@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(edf-budget) begin
+(edf-budget) period 0: full budget
+(edf-budget) period 1: full budget
+(edf-budget) period 2: full budget
+(edf-budget) period 3: full budget
+(edf-budget) period 4: full budget
+(edf-budget) end
+EOF
+pass;
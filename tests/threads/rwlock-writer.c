@@ -0,0 +1,68 @@
+/* Checks that a waiting writer keeps new readers out of a
+   reader-writer lock, so that a stream of readers cannot starve
+   it.
+
+   The main thread holds the lock for reading when a writer and
+   then, at a higher priority still, a reader arrive.  Neither
+   may get in, and neither may a fresh reader attempt by the
+   main thread.  Once the main thread lets go, the writer must
+   get the lock before the reader, even though the reader has
+   the higher priority. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func writer_thread;
+static thread_func reader_thread;
+
+void
+test_rwlock_writer (void) 
+{
+  struct rwlock rw;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rw);
+  rwlock_acquire_read (&rw);
+  msg ("main holds the lock for reading");
+
+  thread_create ("writer", PRI_DEFAULT + 1, writer_thread, &rw);
+  thread_create ("reader", PRI_DEFAULT + 2, reader_thread, &rw);
+
+  if (rwlock_try_acquire_read (&rw))
+    fail ("new reader admitted while a writer waits");
+  msg ("new reader refused while a writer waits");
+
+  msg ("main releasing");
+  rwlock_release_read (&rw);
+  msg ("main done");
+}
+
+static void
+writer_thread (void *rw_) 
+{
+  struct rwlock *rw = rw_;
+
+  msg ("writer waiting");
+  rwlock_acquire_write (rw);
+  msg ("writer acquired");
+  rwlock_release_write (rw);
+}
+
+static void
+reader_thread (void *rw_) 
+{
+  struct rwlock *rw = rw_;
+
+  msg ("reader waiting");
+  rwlock_acquire_read (rw);
+  msg ("reader acquired");
+  rwlock_release_read (rw);
+}
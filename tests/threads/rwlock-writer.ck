@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-writer) begin
+(rwlock-writer) main holds the lock for reading
+(rwlock-writer) writer waiting
+(rwlock-writer) reader waiting
+(rwlock-writer) new reader refused while a writer waits
+(rwlock-writer) main releasing
+(rwlock-writer) writer acquired
+(rwlock-writer) reader acquired
+(rwlock-writer) main done
+(rwlock-writer) end
+EOF
+pass;
@@ -29,6 +29,11 @@ static const struct test tests[] =
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
     {"priority-condvar", test_priority_condvar},
+    {"rwlock-writer", test_rwlock_writer},
+    {"workqueue-flush", test_workqueue_flush},
+    {"cfs-weight", test_cfs_weight},
+    {"edf-admission", test_edf_admission},
+    {"edf-budget", test_edf_budget},
     {"mlfqs-load-1", test_mlfqs_load_1},
     {"mlfqs-load-60", test_mlfqs_load_60},
     {"mlfqs-load-avg", test_mlfqs_load_avg},
@@ -23,6 +23,11 @@ extern test_func test_priority_fifo;
 extern test_func test_priority_preempt;
 extern test_func test_priority_sema;
 extern test_func test_priority_condvar;
+extern test_func test_rwlock_writer;
+extern test_func test_workqueue_flush;
+extern test_func test_cfs_weight;
+extern test_func test_edf_admission;
+extern test_func test_edf_budget;
 extern test_func test_mlfqs_load_1;
 extern test_func test_mlfqs_load_60;
 extern test_func test_mlfqs_load_avg;
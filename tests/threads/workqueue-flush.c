@@ -0,0 +1,77 @@
+/* Checks that workqueue_flush() waits for exactly the work that
+   is queued, and that cancel_work() keeps canceled work from
+   running, whether it was queued or delayed.
+
+   The queue's worker runs below the main thread's priority, so
+   nothing runs until the main thread blocks in the flush. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "threads/workqueue.h"
+#include "devices/timer.h"
+
+#define WORK_CNT 5
+
+static work_func record_work;
+static struct work works[WORK_CNT];
+static bool ran[WORK_CNT];
+
+void
+test_workqueue_flush (void) 
+{
+  struct workqueue *wq;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  wq = workqueue_create ("wq-test", PRI_DEFAULT - 1, 1);
+  if (wq == NULL)
+    fail ("workqueue_create failed");
+  for (i = 0; i < WORK_CNT; i++)
+    work_init (&works[i], record_work, (void *) (intptr_t) i);
+
+  for (i = 0; i < 4; i++)
+    queue_work (wq, &works[i]);
+  queue_delayed_work (wq, &works[4], 10);
+  msg ("queued four works and delayed one");
+
+  if (queue_work (wq, &works[0]))
+    fail ("work queued twice");
+  msg ("second queue of a queued work refused");
+
+  if (!cancel_work (&works[3]))
+    fail ("could not cancel a queued work");
+  msg ("canceled a queued work");
+  if (!cancel_work (&works[4]))
+    fail ("could not cancel a delayed work");
+  msg ("canceled a delayed work");
+  if (cancel_work (&works[4]))
+    fail ("canceled an idle work");
+  msg ("cancel of an idle work refused");
+
+  msg ("flushing");
+  workqueue_flush (wq);
+  msg ("flushed");
+
+  /* Give the canceled delayed work time to have come due. */
+  timer_sleep (20);
+  for (i = 0; i < WORK_CNT; i++)
+    if (ran[i] != (i < 3))
+      fail ("work %d %s", i, ran[i] ? "ran" : "did not run");
+  msg ("canceled works did not run");
+}
+
+static void
+record_work (void *aux) 
+{
+  int i = (intptr_t) aux;
+
+  msg ("work %d ran", i);
+  ran[i] = true;
+}
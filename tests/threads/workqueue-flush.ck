@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(workqueue-flush) begin
+(workqueue-flush) queued four works and delayed one
+(workqueue-flush) second queue of a queued work refused
+(workqueue-flush) canceled a queued work
+(workqueue-flush) canceled a delayed work
+(workqueue-flush) cancel of an idle work refused
+(workqueue-flush) flushing
+(workqueue-flush) work 0 ran
+(workqueue-flush) work 1 ran
+(workqueue-flush) work 2 ran
+(workqueue-flush) flushed
+(workqueue-flush) canceled works did not run
+(workqueue-flush) end
+EOF
+pass;
@@ -0,0 +1,41 @@
+/* Spins in user mode until getrusage() reports that some user
+   time has passed, and checks that the counters only go forward
+   and that bad arguments are rejected. */
+
+#include <rusage.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Timer ticks of user time to wait for. */
+#define SPIN_TICKS 5
+
+void
+test_main (void) 
+{
+  struct rusage before, after;
+  volatile int i;
+
+  CHECK (getrusage (RUSAGE_SELF, &before) == 0, "getrusage (RUSAGE_SELF)");
+
+  do
+    {
+      for (i = 0; i < 1000000; i++)
+        continue;
+      if (getrusage (RUSAGE_SELF, &after) != 0)
+        fail ("getrusage failed while spinning");
+    }
+  while (after.user_ticks - before.user_ticks < SPIN_TICKS);
+  msg ("user time advanced");
+
+  if (after.kernel_ticks < before.kernel_ticks
+      || after.voluntary_switches < before.voluntary_switches
+      || after.involuntary_switches < before.involuntary_switches
+      || after.ready_ns < before.ready_ns
+      || after.blocked_ns < before.blocked_ns)
+    fail ("counters went backward");
+
+  CHECK (getrusage (-1, &after) == -1, "getrusage (-1) must fail");
+  CHECK (getrusage (RUSAGE_SELF, NULL) == -1,
+         "getrusage into a null pointer must fail");
+}
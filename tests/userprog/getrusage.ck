@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(getrusage) begin
+(getrusage) getrusage (RUSAGE_SELF)
+(getrusage) user time advanced
+(getrusage) getrusage (-1) must fail
+(getrusage) getrusage into a null pointer must fail
+(getrusage) end
+getrusage: exit(0)
+EOF
+pass;
@@ -0,0 +1,40 @@
+/* Checks that page faults are counted by cause: touching pages
+   of initialized data must count lazy loads, and touching pages
+   of uninitialized data must count zero fills. */
+
+#include <syscall.h>
+#include <stdint.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 4
+
+/* Fault causes, as in enum vm_fault_cause. */
+#define FAULT_LAZY 0
+#define FAULT_ZERO 1
+
+/* Page-aligned, so that no other variable shares their pages. */
+static char data[PAGE_CNT * PAGE_SIZE] __attribute__ ((aligned (PAGE_SIZE)))
+  = {1};
+static char bss[PAGE_CNT * PAGE_SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+
+void
+test_main (void)
+{
+	long long lazy, zero;
+	size_t i;
+
+	lazy = get_vm_stat (FAULT_LAZY, false);
+	zero = get_vm_stat (FAULT_ZERO, false);
+	for (i = 0; i < PAGE_CNT; i++) {
+		data[i * PAGE_SIZE]++;
+		bss[i * PAGE_SIZE]++;
+	}
+	lazy = get_vm_stat (FAULT_LAZY, false) - lazy;
+	zero = get_vm_stat (FAULT_ZERO, false) - zero;
+
+	CHECK (lazy >= PAGE_CNT, "lazy faults counted");
+	CHECK (zero >= PAGE_CNT, "zero faults counted");
+	CHECK (get_vm_stat (FAULT_LAZY, true) >= lazy, "global lazy count");
+}
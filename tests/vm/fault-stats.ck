@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fault-stats) begin
+(fault-stats) lazy faults counted
+(fault-stats) zero faults counted
+(fault-stats) global lazy count
+(fault-stats) end
+EOF
+pass;
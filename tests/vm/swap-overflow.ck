@@ -0,0 +1,29 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(swap-overflow) begin
+(swap-overflow) write sparsely over page 0
+(swap-overflow) write sparsely over page 512
+(swap-overflow) write sparsely over page 1024
+(swap-overflow) write sparsely over page 1536
+(swap-overflow) write sparsely over page 2048
+(swap-overflow) write sparsely over page 2560
+(swap-overflow) write sparsely over page 3072
+(swap-overflow) write sparsely over page 3584
+(swap-overflow) write sparsely over page 4096
+(swap-overflow) write sparsely over page 4608
+(swap-overflow) check consistency in page 0
+(swap-overflow) check consistency in page 512
+(swap-overflow) check consistency in page 1024
+(swap-overflow) check consistency in page 1536
+(swap-overflow) check consistency in page 2048
+(swap-overflow) check consistency in page 2560
+(swap-overflow) check consistency in page 3072
+(swap-overflow) check consistency in page 3584
+(swap-overflow) check consistency in page 4096
+(swap-overflow) check consistency in page 4608
+(swap-overflow) end
+EOF
+pass;
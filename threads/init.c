@@ -18,9 +18,14 @@
 #include "threads/loader.h"
 #include "threads/malloc.h"
 #include "threads/mmu.h"
+#include "threads/mp.h"
 #include "threads/palloc.h"
+#include "threads/profile.h"
 #include "threads/pte.h"
+#include "threads/sched-trace.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/workqueue.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -94,6 +99,8 @@ main (void) {
 
 	/* Initialize interrupt handlers. */
 	intr_init ();
+	lock_stat_init ();
+	sched_trace_init ();
 	timer_init ();
 	kbd_init ();
 	input_init ();
@@ -103,8 +110,13 @@ main (void) {
 #endif
 	/* Start thread scheduler and enable interrupts. */
 	thread_start ();
+	workqueue_init ();
+#ifdef USERPROG
+	process_reaper_init ();
+#endif
 	serial_init_queue ();
 	timer_calibrate ();
+	mp_init ();
 
 #ifdef FILESYS
 	/* Initialize file system. */
@@ -221,16 +233,45 @@ parse_options (char **argv) {
 			random_init (atoi (value));
 		else if (!strcmp (name, "-mlfqs"))
 			thread_mlfqs = true;
+		else if (!strcmp (name, "-cfs"))
+			thread_cfs = true;
+		else if (!strcmp (name, "-tickless"))
+			timer_tickless = true;
+		else if (!strcmp (name, "-smp"))
+			mp_enabled = true;
+		else if (!strcmp (name, "-sched-trace"))
+			sched_trace = true;
+		else if (!strcmp (name, "-profile"))
+			profile_enabled = true;
 #ifdef USERPROG
 		else if (!strcmp (name, "-ul"))
 			user_page_limit = atoi (value);
 		else if (!strcmp (name, "-threads-tests"))
 			thread_tests = true;
+#endif
+#ifdef VM
+		else if (!strcmp (name, "-swap-scratch"))
+			swap_scratch = true;
 #endif
 		else
 			PANIC ("unknown option `%s' (use -h for help)", name);
 	}
 
+#ifdef VM
+	/* With -swap-scratch, the scratch disk turns into swap after the
+	   leading `put' actions, so nothing may use it after them. */
+	if (swap_scratch) {
+		char **action = argv;
+
+		while (action[0] != NULL && !strcmp (action[0], "put")
+		       && action[1] != NULL)
+			action += 2;
+		for (; *action != NULL; action++)
+			if (!strcmp (*action, "put") || !strcmp (*action, "get"))
+				PANIC ("-swap-scratch cannot be combined with `%s'", *action);
+	}
+#endif
+
 	return argv;
 }
 
@@ -292,6 +333,12 @@ run_actions (char **argv) {
 			if (argv[i] == NULL)
 				PANIC ("action `%s' requires %d argument(s)", *argv, a->argc - 1);
 
+#ifdef VM
+		/* The leading `put's are done with the scratch disk. */
+		if (strcmp (a->name, "put"))
+			swap_scratch_attach ();
+#endif
+
 		/* Invoke action and advance. */
 		a->function (argv);
 		argv += a->argc;
@@ -326,8 +373,16 @@ usage (void) {
 			"  -f                 Format file system disk during startup.\n"
 			"  -rs=SEED           Set random number seed to SEED.\n"
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
+			"  -cfs               Use completely fair scheduler.\n"
+			"  -tickless          Stop the periodic timer tick while idle.\n"
+			"  -smp               Start the other CPUs and park them.\n"
+			"  -sched-trace       Record scheduler events; dump at power off.\n"
+			"  -profile           Sample execution each tick; dump at power off.\n"
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+			"  -swap-scratch      Overflow swap to the scratch disk (after any put).\n"
 #endif
 			);
 	power_off ();
@@ -362,4 +417,11 @@ print_stats (void) {
 #ifdef USERPROG
 	exception_print_stats ();
 #endif
+#ifdef VM
+	vm_print_stats ();
+#endif
+	lock_print_stats ();
+	intr_print_stats ();
+	sched_trace_dump ();
+	profile_dump ();
 }
@@ -9,6 +9,7 @@
 #include "threads/thread.h"
 #include "threads/mmu.h"
 #include "threads/vaddr.h"
+#include "devices/lapic.h"
 #include "devices/timer.h"
 #include "intrinsic.h"
 #ifdef USERPROG
@@ -110,6 +111,46 @@ static void pic_end_of_interrupt (int irq);
 /* Interrupt handlers. */
 void intr_handler (struct intr_frame *args);
 
+#ifdef INTR_LATENCY
+/* Interrupts-off latency tracer.
+
+   Built only with -DINTR_LATENCY, for instance by adding
+   "os.dsk: DEFINES += -DINTR_LATENCY" to a project's Make.vars.
+   Each section of code that runs with interrupts off is timed
+   with the TSC, from the call to intr_disable() or
+   intr_set_level() that turned them off, or from the entry of an
+   interrupt that arrived while they were on, to the call that
+   turned them back on or the end of that interrupt's handling.
+   The INTR_LATENCY_TOP sections that ran longest, by where they
+   started, are kept and printed at power off.
+
+   Interrupts turned on or off behind this code's back, as by
+   "sti; hlt" in the idle thread or by iretq, are not seen; a
+   section whose start was not seen is not recorded. */
+#define INTR_LATENCY_TOP 16
+
+/* Longest interrupts-off sections starting at one place. */
+struct intr_off_site {
+	const void *disabled_at;    /* Return address into the code that
+	                               turned interrupts off, or handler. */
+	const void *enabled_at;     /* Where the longest one ended. */
+	uint64_t max_cycles;        /* Longest, in TSC cycles. */
+	uint64_t total_cycles;      /* Sum, in TSC cycles. */
+	uint64_t cnt;               /* Number of sections. */
+};
+
+static struct intr_off_site off_sites[INTR_LATENCY_TOP];
+static size_t off_site_cnt;
+static uint64_t off_start;              /* TSC at section start, or 0. */
+static const void *off_site;            /* Where it started. */
+
+static void latency_begin (const void *site);
+static void latency_end (const void *site);
+#endif
+
+static enum intr_level enable (const void *site);
+static enum intr_level disable (const void *site);
+
 /* Returns the current interrupt status. */
 enum intr_level
 intr_get_level (void) {
@@ -128,15 +169,33 @@ intr_get_level (void) {
    returns the previous interrupt status. */
 enum intr_level
 intr_set_level (enum intr_level level) {
-	return level == INTR_ON ? intr_enable () : intr_disable ();
+	const void *site = __builtin_return_address (0);
+	return level == INTR_ON ? enable (site) : disable (site);
 }
 
 /* Enables interrupts and returns the previous interrupt status. */
 enum intr_level
 intr_enable (void) {
+	return enable (__builtin_return_address (0));
+}
+
+/* Disables interrupts and returns the previous interrupt status. */
+enum intr_level
+intr_disable (void) {
+	return disable (__builtin_return_address (0));
+}
+
+/* Enables interrupts on behalf of the code at SITE. */
+static enum intr_level
+enable (const void *site UNUSED) {
 	enum intr_level old_level = intr_get_level ();
 	ASSERT (!intr_context ());
 
+#ifdef INTR_LATENCY
+	if (old_level == INTR_OFF)
+		latency_end (site);
+#endif
+
 	/* Enable interrupts by setting the interrupt flag.
 
 	   See [IA32-v2b] "STI" and [IA32-v3a] 5.8.1 "Masking Maskable
@@ -146,9 +205,9 @@ intr_enable (void) {
 	return old_level;
 }
 
-/* Disables interrupts and returns the previous interrupt status. */
-enum intr_level
-intr_disable (void) {
+/* Disables interrupts on behalf of the code at SITE. */
+static enum intr_level
+disable (const void *site UNUSED) {
 	enum intr_level old_level = intr_get_level ();
 
 	/* Disable interrupts by clearing the interrupt flag.
@@ -156,9 +215,96 @@ intr_disable (void) {
 	   Hardware Interrupts". */
 	asm volatile ("cli" : : : "memory");
 
+#ifdef INTR_LATENCY
+	if (old_level == INTR_ON)
+		latency_begin (site);
+#endif
+
 	return old_level;
 }
 
+#ifdef INTR_LATENCY
+/* Starts timing an interrupts-off section that began at SITE.
+   Interrupts must be off. */
+static void
+latency_begin (const void *site) {
+	off_site = site;
+	off_start = rdtsc ();
+}
+
+/* Ends the current interrupts-off section at SITE, and keeps it
+   if it is among the longest.  Interrupts must be off. */
+static void
+latency_end (const void *site) {
+	struct intr_off_site *s = NULL;
+	uint64_t cycles;
+	size_t i;
+
+	if (off_start == 0)
+		return;
+	cycles = rdtsc () - off_start;
+	off_start = 0;
+
+	for (i = 0; i < off_site_cnt; i++)
+		if (off_sites[i].disabled_at == off_site) {
+			s = &off_sites[i];
+			break;
+		}
+	if (s == NULL) {
+		/* New site: take a free slot, or the shortest one's if
+		   this section is longer. */
+		if (off_site_cnt < INTR_LATENCY_TOP)
+			s = &off_sites[off_site_cnt++];
+		else {
+			s = &off_sites[0];
+			for (i = 1; i < off_site_cnt; i++)
+				if (off_sites[i].max_cycles < s->max_cycles)
+					s = &off_sites[i];
+			if (s->max_cycles >= cycles)
+				return;
+		}
+		s->disabled_at = off_site;
+		s->max_cycles = s->total_cycles = s->cnt = 0;
+	}
+	s->cnt++;
+	s->total_cycles += cycles;
+	if (cycles > s->max_cycles) {
+		s->max_cycles = cycles;
+		s->enabled_at = site;
+	}
+}
+#endif
+
+/* Prints the longest interrupts-off sections, if the kernel was
+   built with INTR_LATENCY. */
+void
+intr_print_stats (void) {
+#ifdef INTR_LATENCY
+	struct intr_off_site *sorted[INTR_LATENCY_TOP];
+	uint64_t hz = timer_tsc_hz ();
+	size_t i, j;
+
+	for (i = 0; i < off_site_cnt; i++) {
+		for (j = i; j > 0 && sorted[j - 1]->max_cycles < off_sites[i].max_cycles;
+				j--)
+			sorted[j] = sorted[j - 1];
+		sorted[j] = &off_sites[i];
+	}
+
+	if (off_site_cnt > 0)
+		printf ("Intr-off: %12s %10s %12s %8s  %-18s  %s\n", "max cycles",
+				"max us", "avg cycles", "count", "disabled at", "enabled at");
+	for (i = 0; i < off_site_cnt; i++) {
+		const struct intr_off_site *s = sorted[i];
+
+		printf ("Intr-off: %12"PRIu64" %10"PRIu64" %12"PRIu64" %8"PRIu64
+				"  %-18p  %p\n", s->max_cycles,
+				hz != 0 ? s->max_cycles * 1000000 / hz : 0,
+				s->total_cycles / s->cnt, s->cnt, s->disabled_at, s->enabled_at);
+	}
+#endif
+}
+
 /* Initializes the interrupt system. */
 void
 intr_init (void) {
@@ -221,13 +367,20 @@ register_handler (uint8_t vec_no, int dpl, enum intr_level level,
 	intr_names[vec_no] = name;
 }
 
+/* Returns true if VEC_NO is an external interrupt: one routed
+   through the PICs, or one raised by the local APIC. */
+static bool
+is_external (uint8_t vec_no) {
+	return (vec_no >= 0x20 && vec_no <= 0x2f) || vec_no >= LAPIC_VEC_MIN;
+}
+
 /* Registers external interrupt VEC_NO to invoke HANDLER, which
    is named NAME for debugging purposes.  The handler will
    execute with interrupts disabled. */
 void
 intr_register_ext (uint8_t vec_no, intr_handler_func *handler,
 		const char *name) {
-	ASSERT (vec_no >= 0x20 && vec_no <= 0x2f);
+	ASSERT (is_external (vec_no));
 	register_handler (vec_no, 0, INTR_OFF, handler, name);
 }
 
@@ -248,10 +401,22 @@ void
 intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
 		intr_handler_func *handler, const char *name)
 {
-	ASSERT (vec_no < 0x20 || vec_no > 0x2f);
+	ASSERT (!is_external (vec_no));
 	register_handler (vec_no, dpl, level, handler, name);
 }
 
+/* Makes the CPU switch to the stack in slot IST (1...7) of the
+   TSS's interrupt stack table whenever it delivers interrupt
+   VEC_NO, or, if IST is 0, stay on the current kernel stack.  For
+   faults that must be handled even when the current stack is
+   unusable. */
+void
+intr_set_ist (uint8_t vec_no, int ist) {
+	ASSERT (ist >= 0 && ist <= 7);
+	ASSERT (intr_handlers[vec_no] != NULL);
+	idt[vec_no].ist = ist;
+}
+
 /* Returns true during processing of an external interrupt
    and false at all other times. */
 bool
@@ -308,6 +473,20 @@ pic_init (void) {
 	outb (0xa1, 0x00);
 }
 
+/* Masks external interrupt VEC_NO at the PICs if MASK is true,
+   otherwise unmasks it. */
+void
+intr_mask_ext (uint8_t vec_no, bool mask) {
+	uint16_t port = vec_no < 0x28 ? 0x21 : 0xa1;
+	uint8_t bit = 1 << (vec_no & 7);
+	uint8_t imr;
+
+	ASSERT (vec_no >= 0x20 && vec_no < 0x30);
+
+	imr = inb (port);
+	outb (port, mask ? imr | bit : imr & ~bit);
+}
+
 /* Sends an end-of-interrupt signal to the PIC for the given IRQ.
    If we don't acknowledge the IRQ, it will never be delivered to
    us again, so this is important.  */
@@ -337,7 +516,14 @@ intr_handler (struct intr_frame *frame) {
 	   We only handle one at a time (so interrupts must be off)
 	   and they need to be acknowledged on the PIC (see below).
 	   An external interrupt handler cannot sleep. */
-	external = frame->vec_no >= 0x20 && frame->vec_no < 0x30;
+	external = is_external (frame->vec_no);
+	handler = intr_handlers[frame->vec_no];
+#ifdef INTR_LATENCY
+	/* Interrupts were turned off by the interrupt's arrival. */
+	if (frame->eflags & FLAG_IF)
+		latency_begin (handler != NULL ? (const void *) handler
+				: (const void *) intr_handler);
+#endif
 	if (external) {
 		ASSERT (intr_get_level () == INTR_OFF);
 		ASSERT (!intr_context ());
@@ -347,10 +533,10 @@ intr_handler (struct intr_frame *frame) {
 	}
 
 	/* Invoke the interrupt's handler. */
-	handler = intr_handlers[frame->vec_no];
 	if (handler != NULL)
 		handler (frame);
-	else if (frame->vec_no == 0x27 || frame->vec_no == 0x2f) {
+	else if (frame->vec_no == 0x27 || frame->vec_no == 0x2f
+			|| frame->vec_no == LAPIC_SPURIOUS_VEC) {
 		/* There is no handler, but this interrupt can trigger
 		   spuriously due to a hardware fault or hardware race
 		   condition.  Ignore it. */
@@ -367,11 +553,22 @@ intr_handler (struct intr_frame *frame) {
 		ASSERT (intr_context ());
 
 		in_external_intr = false;
-		pic_end_of_interrupt (frame->vec_no);
+		if (frame->vec_no >= LAPIC_VEC_MIN) {
+			/* Spurious LAPIC interrupts must not be acknowledged. */
+			if (frame->vec_no != LAPIC_SPURIOUS_VEC)
+				lapic_eoi ();
+		} else
+			pic_end_of_interrupt (frame->vec_no);
 
 		if (yield_on_return)
 			thread_yield ();
 	}
+
+#ifdef INTR_LATENCY
+	/* Returning will turn interrupts back on. */
+	if ((frame->eflags & FLAG_IF) && intr_get_level () == INTR_OFF)
+		latency_end ((const void *) frame->rip);
+#endif
 }
 
 /* Dumps interrupt frame F to the console, for debugging. */
@@ -71,11 +71,14 @@ malloc_init (void) {
 
 	for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2) {
 		struct desc *d = &descs[desc_cnt++];
+		char name[16];
+
 		ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
 		d->block_size = block_size;
 		d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
 		list_init (&d->free_list);
-		lock_init (&d->lock);
+		snprintf (name, sizeof name, "malloc%zu", block_size);
+		lock_init_named (&d->lock, name);
 	}
 }
 
@@ -0,0 +1,104 @@
+#include "threads/mp.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/lapic.h"
+#include "devices/timer.h"
+#include "threads/init.h"
+#include "threads/mmu.h"
+#include "threads/spinlock.h"
+#include "threads/vaddr.h"
+
+/* Multiprocessor bring-up.
+
+   The bootstrap processor (BSP) wakes the application processors
+   (APs) with the INIT-SIPI-SIPI sequence of [IA32-v3a] 8.4.4
+   "MP Initialization Example", broadcast to all CPUs but itself.
+   Each AP runs the trampoline in mp-entry.S, enables its local
+   APIC, marks itself online in cpus[] and parks: the scheduler
+   still runs on the BSP alone.
+
+   Only bring-up is done.  There is one run queue, interrupt
+   disabling is still the kernel's lock, and thread_current()
+   assumes a thread stack, so an AP may not run threads until
+   those are made per-CPU. */
+
+/* Per-CPU data.  cpus[0] is the BSP. */
+struct cpu cpus[CPU_MAX];
+int cpu_cnt = 1;
+
+/* Protects CPU_CNT, which the APs count themselves into as they
+   come up, concurrently with each other. */
+static struct spinlock cpu_cnt_lock = SPINLOCK_INITIALIZER;
+
+bool mp_enabled;
+
+/* Shared with ap_entry in mp-entry.S. */
+uint64_t mp_ap_cr3;                     /* Kernel page map, physical. */
+int mp_ap_next;                         /* Next AP index to hand out. */
+uint8_t mp_ap_stacks[CPU_MAX - 1][PGSIZE] __attribute__ ((aligned (PGSIZE)));
+
+extern char mp_trampoline[], mp_trampoline_end[];
+
+void ap_main (int idx) NO_RETURN;
+
+/* Records the BSP in cpus[] and, if enabled by "-smp", starts
+   the APs.  Must be called after timer_calibrate(), which sets up
+   the BSP's local APIC. */
+void
+mp_init (void) {
+	struct cpu *bsp = &cpus[0];
+	int i;
+
+	bsp->id = 0;
+	bsp->online = true;
+	if (lapic_present ())
+		bsp->apic_id = lapic_id ();
+
+	if (!mp_enabled)
+		return;
+	if (!lapic_present ()) {
+		printf ("smp: no local APIC, running on one CPU.\n");
+		return;
+	}
+
+	memcpy (ptov (MP_TRAMPOLINE), mp_trampoline,
+			mp_trampoline_end - mp_trampoline);
+	mp_ap_cr3 = vtop (base_pml4);
+
+	lapic_ipi_others (LAPIC_IPI_INIT);
+	timer_msleep (10);
+	for (i = 0; i < 2; i++) {
+		lapic_ipi_others (LAPIC_IPI_STARTUP | (MP_TRAMPOLINE >> PGBITS));
+		timer_usleep (200);
+	}
+
+	/* There is no way to know how many APs there are short of
+	   parsing ACPI tables, so give them all ample time. */
+	timer_msleep (100);
+	enum intr_level old_level = spin_lock_irqsave (&cpu_cnt_lock);
+	i = cpu_cnt;
+	spin_unlock_irqrestore (&cpu_cnt_lock, old_level);
+	printf ("smp: %d CPUs online.\n", i);
+}
+
+/* C entry point of AP number IDX, called by ap_entry in
+   mp-entry.S on its own stack with the kernel's page tables
+   loaded and interrupts off.  Never returns: the AP halts with
+   interrupts off, so it takes no part in scheduling. */
+void
+ap_main (int idx) {
+	struct cpu *c = &cpus[idx + 1];
+
+	lapic_init_ap ();
+	c->id = idx + 1;
+	c->apic_id = lapic_id ();
+
+	spin_lock (&cpu_cnt_lock);
+	c->online = true;
+	cpu_cnt++;
+	spin_unlock (&cpu_cnt_lock);
+
+	for (;;)
+		asm volatile ("cli; hlt" : : : "memory");
+}
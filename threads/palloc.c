@@ -8,8 +8,10 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
@@ -24,13 +26,31 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Each pool also keeps a small reserve of free pages that were
+   zeroed ahead of time by the idle thread (see
+   palloc_prezero_page()).  Single-page PAL_ZERO requests are
+   served from the reserve first, so the memset does not land on
+   the caller's critical path.  Pages in the reserve are marked
+   used in the pool's bitmap and are linked through their first
+   word, which is cleared again when the page is handed out. */
+
+/* Maximum number of pre-zeroed pages kept in each pool. */
+#define ZERO_POOL_PAGES 32
+
+/* Most free-map bits that one refill examines. */
+#define ZERO_SCAN_BITS 64
 
 /* A memory pool. */
 struct pool {
 	struct lock lock;               /* Mutual exclusion. */
 	struct bitmap *used_map;        /* Bitmap of free pages. */
 	uint8_t *base;                  /* Base of pool. */
+
+	void **zero_pages;              /* Stack of pre-zeroed pages. */
+	size_t zero_cnt;                /* Number of pages in zero_pages. */
+	size_t zero_scan;               /* Where the next refill looks. */
 };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -39,9 +59,13 @@ static struct pool kernel_pool, user_pool;
 /* Maximum number of pages to put in user pool. */
 size_t user_page_limit = SIZE_MAX;
 static void
-init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end);
+init_pool (struct pool *p, const char *name, void **bm_base,
+		uint64_t start, uint64_t end);
 
 static bool page_from_pool (const struct pool *, void *page);
+static void *zero_pool_pop (struct pool *);
+static bool zero_pool_refill (struct pool *);
+static bool zero_pool_drain (struct pool *);
 
 /* multiboot info */
 struct multiboot_info {
@@ -158,7 +182,7 @@ populate_pools (struct area *base_mem, struct area *ext_mem) {
 						break;
 					}
 					// generate kernel pool
-					init_pool (&kernel_pool,
+					init_pool (&kernel_pool, "kernel pool",
 							&free_start, region_start, start + rem * PGSIZE);
 					// Transition to the next state
 					if (rem == size_in_pg) {
@@ -188,7 +212,7 @@ populate_pools (struct area *base_mem, struct area *ext_mem) {
 	}
 
 	// generate the user pool
-	init_pool(&user_pool, &free_start, region_start, end);
+	init_pool (&user_pool, "user pool", &free_start, region_start, end);
 
 	// Iterate over the e820_entry. Setup the usable.
 	uint64_t usable_bound = (uint64_t) free_start;
@@ -262,11 +286,29 @@ palloc_init (void) {
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
 	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	void *pages;
+
+	/* A single zeroed page can usually come straight out of the
+	   pre-zeroed reserve. */
+	if ((flags & PAL_ZERO) && page_cnt == 1) {
+		pages = zero_pool_pop (pool);
+		if (pages != NULL)
+			return pages;
+	}
 
 	lock_acquire (&pool->lock);
 	size_t page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+	if (page_idx == BITMAP_ERROR && zero_pool_drain (pool))
+		page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
 	lock_release (&pool->lock);
-	void *pages;
+
+	/* Then the pages cached for new threads. */
+	if (page_idx == BITMAP_ERROR && pool == &kernel_pool
+			&& thread_cache_trim ()) {
+		lock_acquire (&pool->lock);
+		page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+		lock_release (&pool->lock);
+	}
 
 	if (page_idx != BITMAP_ERROR)
 		pages = pool->base + PGSIZE * page_idx;
@@ -328,18 +370,37 @@ palloc_free_page (void *page) {
 	palloc_free_multiple (page, 1);
 }
 
-/* Initializes pool P as starting at START and ending at END */
+/* Zeroes one free page ahead of time and adds it to its pool's
+   reserve, preferring the kernel pool.  Returns true if a page
+   was zeroed, false if both reserves are full or no page could
+   be taken without sleeping.  A false return may only mean that
+   the stretch of free map examined was full; the next call looks
+   further on.
+
+   Meant to be called from the idle thread, so it never blocks: a
+   pool whose lock is held is simply skipped. */
+bool
+palloc_prezero_page (void) {
+	return zero_pool_refill (&kernel_pool) || zero_pool_refill (&user_pool);
+}
+
+/* Initializes pool P, named NAME, as starting at START and ending
+   at END */
 static void
-init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
+init_pool (struct pool *p, const char *name, void **bm_base,
+		uint64_t start, uint64_t end) {
   /* We'll put the pool's used_map at its base.
      Calculate the space needed for the bitmap
      and subtract it from the pool's size. */
 	uint64_t pgcnt = (end - start) / PGSIZE;
 	size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (pgcnt), PGSIZE) * PGSIZE;
 
-	lock_init(&p->lock);
+	lock_init_named (&p->lock, name);
 	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_pages);
 	p->base = (void *) start;
+	p->zero_pages = NULL;
+	p->zero_cnt = 0;
+	p->zero_scan = 0;
 
 	// Mark all to unusable.
 	bitmap_set_all(p->used_map, true);
@@ -356,3 +417,89 @@ page_from_pool (const struct pool *pool, void *page) {
 	size_t end_page = start_page + bitmap_size (pool->used_map);
 	return page_no >= start_page && page_no < end_page;
 }
+
+/* Removes and returns a page from P's pre-zeroed reserve, or a
+   null pointer if the reserve is empty. */
+static void *
+zero_pool_pop (struct pool *p) {
+	enum intr_level old_level = intr_disable ();
+	void **page = p->zero_pages;
+	if (page != NULL) {
+		p->zero_pages = *page;
+		p->zero_cnt--;
+	}
+	intr_set_level (old_level);
+
+	/* The link was the only non-zero word in the page. */
+	if (page != NULL)
+		*page = NULL;
+	return page;
+}
+
+/* Takes one free page from P, zeroes it and pushes it onto P's
+   reserve.  Returns false without sleeping if the reserve is
+   full, the pool lock is busy or no free page turned up.
+
+   The idle thread must never be seen holding P's lock: it only
+   runs when no other thread is ready, so a thread that blocked
+   on a lock that idle held would wait until the system went idle
+   again, and priority donation cannot make idle run any sooner.
+   So the lock is only tried, and held, with interrupts off.  To
+   keep that stretch short, each call examines at most
+   ZERO_SCAN_BITS bits of the free map, resuming where the last
+   call stopped. */
+static bool
+zero_pool_refill (struct pool *p) {
+	enum intr_level old_level;
+	size_t page_idx = BITMAP_ERROR;
+	size_t bit_cnt = bitmap_size (p->used_map);
+	size_t i;
+	void **page;
+
+	old_level = intr_disable ();
+	if (p->zero_cnt < ZERO_POOL_PAGES && lock_try_acquire (&p->lock)) {
+		for (i = 0; i < ZERO_SCAN_BITS && i < bit_cnt; i++) {
+			size_t idx = p->zero_scan;
+
+			p->zero_scan = idx + 1 < bit_cnt ? idx + 1 : 0;
+			if (!bitmap_test (p->used_map, idx)) {
+				bitmap_mark (p->used_map, idx);
+				page_idx = idx;
+				break;
+			}
+		}
+		lock_release (&p->lock);
+	}
+	intr_set_level (old_level);
+	if (page_idx == BITMAP_ERROR)
+		return false;
+
+	page = (void **) (p->base + PGSIZE * page_idx);
+	memset (page, 0, PGSIZE);
+
+	old_level = intr_disable ();
+	*page = p->zero_pages;
+	p->zero_pages = page;
+	p->zero_cnt++;
+	intr_set_level (old_level);
+	return true;
+}
+
+/* Returns every page in P's reserve to P's free map, so that an
+   allocation that found the pool exhausted can retry.  P's lock
+   must be held.  Returns true if any page was released. */
+static bool
+zero_pool_drain (struct pool *p) {
+	bool released = false;
+	void *page;
+
+	ASSERT (lock_held_by_current_thread (&p->lock));
+
+	while ((page = zero_pool_pop (p)) != NULL) {
+		size_t page_idx = pg_no (page) - pg_no (p->base);
+		ASSERT (bitmap_test (p->used_map, page_idx));
+		bitmap_reset (p->used_map, page_idx);
+		released = true;
+	}
+	return released;
+}
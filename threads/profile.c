@@ -0,0 +1,140 @@
+#include "threads/profile.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/thread.h"
+
+/* Sampling profiler.
+
+   With "-profile", every timer tick records where the interrupted
+   code was: its rip, the running thread's tid, whether it was in
+   user or kernel mode and, in kernel mode, the return addresses
+   of up to PROFILE_DEPTH callers, found by following the saved
+   frame pointers (the kernel is built with
+   -fno-omit-frame-pointer).  User stacks are not walked, since
+   they might not be mapped.
+
+   Identical samples share an entry of a fixed-size open-addressed
+   hash table, allocated statically so that sampling never
+   allocates.  Once the table is full, samples that would need a
+   new entry are only counted as dropped.
+
+   profile_dump() prints the table at power off, one entry per
+   line, prefixed "profile:".  "backtrace --profile" symbolizes it
+   into a flat profile or a folded-stack file. */
+
+#define PROFILE_SLOTS 1024              /* Table size; a power of 2. */
+#define PROFILE_DEPTH 6                 /* Kernel callers kept. */
+
+/* Samples with identical locations. */
+struct profile_entry {
+	uint64_t cnt;                       /* Number of samples; 0 if free. */
+	uint64_t rip;                       /* Interrupted instruction. */
+	uint64_t callers[PROFILE_DEPTH];    /* Return addresses, or 0. */
+	tid_t tid;                          /* Running thread. */
+	bool user;                          /* In user mode? */
+};
+
+bool profile_enabled;
+
+static struct profile_entry entries[PROFILE_SLOTS];
+static uint64_t sample_cnt;             /* Samples taken. */
+static uint64_t dropped_cnt;            /* Samples lost to a full table. */
+
+/* Fills CALLERS with the return addresses found by walking the
+   frame-pointer chain from RBP, which must lie within thread T's
+   stack. */
+static void
+walk_stack (const struct thread *t, uintptr_t rbp,
+		uint64_t callers[PROFILE_DEPTH]) {
+	uintptr_t lo = (uintptr_t) t + sizeof *t;
+	uintptr_t hi = (uintptr_t) t + THREAD_STACK_SIZE - 2 * sizeof (uintptr_t);
+	int i;
+
+	for (i = 0; i < PROFILE_DEPTH; i++) {
+		const uintptr_t *frame = (const uintptr_t *) rbp;
+
+		/* Each frame must be above the last one, and on the stack. */
+		if (rbp < lo || rbp > hi || rbp % sizeof (uintptr_t) != 0
+				|| frame[1] == 0)
+			break;
+		callers[i] = frame[1];
+		if (frame[0] <= rbp)
+			break;
+		rbp = frame[0];
+	}
+}
+
+/* Records a sample of the code that interrupt frame F
+   interrupted.  Called by the timer interrupt handler. */
+void
+profile_sample (const struct intr_frame *f) {
+	struct thread *t = thread_current ();
+	struct profile_entry sample;
+	unsigned hash;
+	int i;
+
+	ASSERT (intr_context ());
+
+	memset (&sample, 0, sizeof sample);
+	sample.rip = f->rip;
+	sample.tid = t->tid;
+	sample.user = (f->cs & 3) == 3;
+	if (!sample.user)
+		walk_stack (t, f->R.rbp, sample.callers);
+
+	/* FNV-1a over the location. */
+	hash = 2166136261u;
+	for (i = -1; i < PROFILE_DEPTH; i++) {
+		uint64_t pc = i < 0 ? sample.rip : sample.callers[i];
+		hash = (hash ^ (unsigned) (pc ^ (pc >> 32))) * 16777619u;
+	}
+	hash = (hash ^ (unsigned) sample.tid) * 16777619u;
+
+	sample_cnt++;
+	for (i = 0; i < PROFILE_SLOTS; i++) {
+		struct profile_entry *e = &entries[(hash + i) % PROFILE_SLOTS];
+
+		if (e->cnt == 0) {
+			*e = sample;
+			e->cnt = 1;
+			return;
+		}
+		if (e->rip == sample.rip && e->tid == sample.tid
+				&& e->user == sample.user
+				&& !memcmp (e->callers, sample.callers, sizeof e->callers)) {
+			e->cnt++;
+			return;
+		}
+	}
+	dropped_cnt++;
+}
+
+/* Prints the samples taken so far, as lines of the form
+   "profile: COUNT TID k|u RIP [CALLER...]", innermost caller
+   first. */
+void
+profile_dump (void) {
+	size_t i;
+	int j;
+
+	if (sample_cnt == 0)
+		return;
+
+	printf ("profile: begin samples=%"PRIu64" dropped=%"PRIu64"\n",
+			sample_cnt, dropped_cnt);
+	for (i = 0; i < PROFILE_SLOTS; i++) {
+		const struct profile_entry *e = &entries[i];
+
+		if (e->cnt == 0)
+			continue;
+		printf ("profile: %"PRIu64" %d %c %#"PRIx64, e->cnt, e->tid,
+				e->user ? 'u' : 'k', e->rip);
+		for (j = 0; j < PROFILE_DEPTH && e->callers[j] != 0; j++)
+			printf (" %#"PRIx64, e->callers[j]);
+		printf ("\n");
+	}
+	printf ("profile: end\n");
+}
@@ -0,0 +1,200 @@
+#include "threads/sched-trace.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "intrinsic.h"
+
+/* Scheduler event trace.
+
+   With "-sched-trace", the scheduler records each thread switch,
+   block, wakeup, priority donation and time slice expiry, stamped
+   with the TSC, into a fixed-size ring that keeps the most recent
+   SCHED_TRACE_SIZE events.  A writer claims a slot with a single
+   atomic increment of the ring's head and then fills it in, so
+   recording takes no lock and works from interrupt handlers and
+   from inside schedule().
+
+   sched_trace_dump() prints the ring to the console, and so to
+   the serial port, one event per line, prefixed "sched-trace:".
+   It runs at power off and on int 0x48.  utils/sched-trace2json
+   turns a captured log into a Chrome trace (Perfetto) file. */
+
+#define SCHED_TRACE_SIZE 4096           /* Events kept; a power of 2. */
+
+/* Kinds of events. */
+enum sched_event_type {
+	EV_CREATE,          /* Thread created; NAME is set. */
+	EV_SWITCH,          /* TID switched out for ARG. */
+	EV_BLOCK,           /* TID blocked; WHERE called thread_block(). */
+	EV_WAKEUP,          /* TID unblocked by thread ARG, or -1. */
+	EV_DONATE,          /* TID raised to PRIORITY by thread ARG. */
+	EV_SLICE            /* TID's time slice expired. */
+};
+
+/* One recorded event.  32 bytes. */
+struct sched_event {
+	uint64_t tsc;                       /* Time stamp counter. */
+	uint8_t type;                       /* enum sched_event_type. */
+	uint8_t priority;                   /* TID's priority. */
+	uint8_t arg_priority;               /* ARG's priority, if a thread. */
+	uint8_t status;                     /* TID's new status, for switches. */
+	int32_t tid;                        /* Thread the event is about. */
+	union {
+		struct {
+			int64_t arg;                /* Other thread's tid. */
+			const void *where;          /* Code address. */
+		};
+		char name[16];                  /* Thread name, for EV_CREATE. */
+	};
+};
+
+bool sched_trace;
+
+static struct sched_event events[SCHED_TRACE_SIZE];
+static uint64_t head;                   /* Events ever recorded. */
+
+static void inspect_sched_trace (struct intr_frame *);
+
+/* Lets user programs dump the trace with int 0x48.  Call after
+   intr_init(). */
+void
+sched_trace_init (void) {
+	intr_register_int (0x48, 3, INTR_ON, inspect_sched_trace,
+			"Dump Scheduler Trace");
+}
+
+/* Claims the next slot in the ring for an event of TYPE about
+   thread T, stamps it, and returns it for the caller to fill in
+   the rest. */
+static struct sched_event *
+record (enum sched_event_type type, const struct thread *t) {
+	uint64_t idx = __atomic_fetch_add (&head, 1, __ATOMIC_RELAXED);
+	struct sched_event *e = &events[idx % SCHED_TRACE_SIZE];
+
+	e->tsc = rdtsc ();
+	e->type = type;
+	e->tid = t->tid;
+	e->priority = t->priority;
+	e->arg_priority = 0;
+	e->status = t->status;
+	e->arg = 0;
+	e->where = NULL;
+	return e;
+}
+
+/* Records the creation of T, so that the dump can name it. */
+void
+sched_trace_create (const struct thread *t) {
+	if (sched_trace) {
+		struct sched_event *e = record (EV_CREATE, t);
+		strlcpy (e->name, t->name, sizeof e->name);
+	}
+}
+
+/* Records a switch from PREV, whose status says why it stopped
+   running, to NEXT. */
+void
+sched_trace_switch (const struct thread *prev, const struct thread *next) {
+	if (sched_trace) {
+		struct sched_event *e = record (EV_SWITCH, prev);
+		e->arg = next->tid;
+		e->arg_priority = next->priority;
+	}
+}
+
+/* Records that T is blocking, having been called from WHERE. */
+void
+sched_trace_block (const struct thread *t, const void *where) {
+	if (sched_trace)
+		record (EV_BLOCK, t)->where = where;
+}
+
+/* Records that T is being unblocked, by the running thread or,
+   from an interrupt handler, by the interrupt. */
+void
+sched_trace_wakeup (const struct thread *t) {
+	if (sched_trace) {
+		struct sched_event *e = record (EV_WAKEUP, t);
+		if (intr_context ())
+			e->arg = -1;
+		else {
+			e->arg = thread_current ()->tid;
+			e->arg_priority = thread_current ()->priority;
+		}
+	}
+}
+
+/* Records that DONOR has lent its priority to RECIPIENT. */
+void
+sched_trace_donate (const struct thread *donor,
+		const struct thread *recipient) {
+	if (sched_trace) {
+		struct sched_event *e = record (EV_DONATE, recipient);
+		e->arg = donor->tid;
+		e->arg_priority = donor->priority;
+	}
+}
+
+/* Records that T has used up its time slice. */
+void
+sched_trace_slice (const struct thread *t) {
+	if (sched_trace)
+		record (EV_SLICE, t);
+}
+
+/* Prints the recorded events, oldest first.  Recording stops
+   while printing, so that the console's own wakeups do not
+   overwrite the events being printed. */
+void
+sched_trace_dump (void) {
+	static const char *statuses[] = { "run", "ready", "block", "dying" };
+	bool was_tracing = sched_trace;
+	uint64_t end, i;
+
+	if (head == 0)
+		return;
+
+	sched_trace = false;
+	end = __atomic_load_n (&head, __ATOMIC_ACQUIRE);
+	i = end > SCHED_TRACE_SIZE ? end - SCHED_TRACE_SIZE : 0;
+	printf ("sched-trace: begin tsc_hz=%"PRIu64" events=%"PRIu64
+			" lost=%"PRIu64"\n", timer_tsc_hz (), end - i, i);
+	for (; i < end; i++) {
+		const struct sched_event *e = &events[i % SCHED_TRACE_SIZE];
+
+		printf ("sched-trace: %"PRIu64" ", e->tsc);
+		switch (e->type) {
+			case EV_CREATE:
+				printf ("create %d %d %s\n", e->tid, e->priority, e->name);
+				break;
+			case EV_SWITCH:
+				printf ("switch %d %d %s %"PRId64" %d\n", e->tid, e->priority,
+						statuses[e->status], e->arg, e->arg_priority);
+				break;
+			case EV_BLOCK:
+				printf ("block %d %d %p\n", e->tid, e->priority, e->where);
+				break;
+			case EV_WAKEUP:
+				printf ("wakeup %d %d %"PRId64"\n", e->tid, e->priority, e->arg);
+				break;
+			case EV_DONATE:
+				printf ("donate %d %d %"PRId64"\n", e->tid, e->priority, e->arg);
+				break;
+			case EV_SLICE:
+				printf ("slice %d %d\n", e->tid, e->priority);
+				break;
+			default:
+				NOT_REACHED ();
+		}
+	}
+	printf ("sched-trace: end\n");
+	sched_trace = was_tracing;
+}
+
+static void
+inspect_sched_trace (struct intr_frame *f UNUSED) {
+	sched_trace_dump ();
+}
@@ -0,0 +1,63 @@
+#include "threads/spinlock.h"
+#include <debug.h>
+#include <stddef.h>
+
+/* Initializes spin lock L as unlocked. */
+void
+spin_lock_init (struct spinlock *l) {
+	ASSERT (l != NULL);
+	l->locked = 0;
+}
+
+/* Acquires L, spinning until it is free.  Interrupts should be
+   off, or an interrupt handler that wants L could spin forever on
+   this CPU. */
+void
+spin_lock (struct spinlock *l) {
+	ASSERT (l != NULL);
+
+	while (__atomic_exchange_n (&l->locked, 1, __ATOMIC_ACQUIRE)) {
+		/* Wait with plain reads, so as not to bounce the cache line
+		   between CPUs. */
+		while (l->locked)
+			asm volatile ("pause" : : : "memory");
+	}
+}
+
+/* Tries to acquire L without spinning.  Returns true if
+   successful. */
+bool
+spin_trylock (struct spinlock *l) {
+	ASSERT (l != NULL);
+	return !__atomic_exchange_n (&l->locked, 1, __ATOMIC_ACQUIRE);
+}
+
+/* Releases L. */
+void
+spin_unlock (struct spinlock *l) {
+	ASSERT (spin_lock_held (l));
+	__atomic_store_n (&l->locked, 0, __ATOMIC_RELEASE);
+}
+
+/* Returns true if L is held, by anyone. */
+bool
+spin_lock_held (const struct spinlock *l) {
+	ASSERT (l != NULL);
+	return l->locked != 0;
+}
+
+/* Disables interrupts, then acquires L.  Returns the previous
+   interrupt level, to pass to spin_unlock_irqrestore(). */
+enum intr_level
+spin_lock_irqsave (struct spinlock *l) {
+	enum intr_level old_level = intr_disable ();
+	spin_lock (l);
+	return old_level;
+}
+
+/* Releases L, then restores interrupt level OLD_LEVEL. */
+void
+spin_unlock_irqrestore (struct spinlock *l, enum intr_level old_level) {
+	spin_unlock (l);
+	intr_set_level (old_level);
+}
@@ -27,10 +27,48 @@
    */
 
 #include "threads/synch.h"
+#include <inttypes.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/interrupt.h"
+#include "threads/sched-trace.h"
 #include "threads/thread.h"
+#include "intrinsic.h"
+
+/* Arrival counter for wait queues. */
+static uint64_t wait_seq;
+
+static struct thread *wait_elem_thread (struct wait_elem *);
+static void donate (struct thread *, struct lock *);
+
+/* Lock contention statistics.
+
+   Every lock points to the statistics of its name, which all
+   locks initialized with that name share; unnamed locks share
+   the first entry.  Entries are never freed, so a lock may be
+   freed without unregistering.  Updated with interrupts off. */
+#define LOCK_STAT_MAX 64                /* Distinct lock names. */
+#define LOCK_STAT_HOLDERS 4             /* Holders tracked per name. */
+
+struct lock_stat {
+	char name[16];                      /* Lock name. */
+	uint64_t acquired;                  /* Times acquired. */
+	uint64_t contended;                 /* Times a thread had to wait. */
+	uint64_t wait_cycles;               /* Total TSC cycles waited. */
+	uint64_t max_wait_cycles;           /* Longest wait. */
+	struct {
+		char name[16];                  /* Holder's thread name. */
+		uint64_t cnt;                   /* Times it made someone wait. */
+	} holders[LOCK_STAT_HOLDERS];       /* Worst holders, approximately. */
+};
+
+static struct lock_stat lock_stats[LOCK_STAT_MAX] = { { .name = "(unnamed)" } };
+static size_t lock_stat_cnt = 1;
+
+static struct lock_stat *lock_stat_lookup (const char *name);
+static void lock_stat_record (struct lock_stat *, const struct thread *holder,
+		uint64_t wait_cycles);
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -46,7 +84,7 @@ sema_init (struct semaphore *sema, unsigned value) {
 	ASSERT (sema != NULL);
 
 	sema->value = value;
-	list_init (&sema->waiters);
+	wait_queue_init (&sema->waiters);
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -66,7 +104,7 @@ sema_down (struct semaphore *sema) {
 
 	old_level = intr_disable ();
 	while (sema->value == 0) {
-		list_insert_ordered (&sema->waiters, &thread_current ()->elem, cmp_prior, NULL);
+		wait_queue_push (&sema->waiters, thread_current ());
 		thread_block ();
 	}
 	sema->value--;
@@ -104,15 +142,12 @@ sema_try_down (struct semaphore *sema) {
 void
 sema_up (struct semaphore *sema) {
 	enum intr_level old_level;
-	struct list_elem *first = NULL;
 
 	ASSERT (sema != NULL);
 
 	old_level = intr_disable ();
-	if (!list_empty (&sema->waiters)){
-		list_sort(&sema->waiters, cmp_prior, NULL);
-		thread_unblock (list_entry (list_pop_front (&sema->waiters), struct thread, elem));
-	}
+	if (!wait_queue_empty (&sema->waiters))
+		thread_unblock (wait_queue_pop (&sema->waiters));
 	sema->value++;
 	if(!intr_context ())
 		thread_yield();
@@ -174,10 +209,19 @@ sema_test_helper (void *sema_) {
    instead of a lock. */
 void
 lock_init (struct lock *lock) {
+	lock_init_named (lock, NULL);
+}
+
+/* Initializes LOCK, like lock_init(), and files its contention
+   statistics under NAME, which may be a null pointer.  Locks that
+   serve the same purpose may share a name. */
+void
+lock_init_named (struct lock *lock, const char *name) {
 	ASSERT (lock != NULL);
 
 	lock->holder = NULL;
 	sema_init (&lock->semaphore, 1);
+	lock->stat = lock_stat_lookup (name);
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -195,17 +239,28 @@ lock_acquire (struct lock *lock) {
 	ASSERT (!lock_held_by_current_thread (lock));
 
 	struct thread *cur = thread_current ();
-	if (lock->holder){
-		enum intr_level old_level = intr_disable();
-		list_insert_ordered(&lock->holder->prior_his, &cur->prior_elem, cmp_prior_elem , NULL);
-		cur->lock = lock;
-		donate(lock);
-		intr_set_level(old_level);
+	enum intr_level old_level = intr_disable ();
+	struct thread *holder = lock->holder;
+	uint64_t start = 0;
+
+	if (holder != NULL) {
+		start = rdtsc ();
+		if (!thread_mlfqs) {
+			cur->lock = lock;
+			donate (cur, lock);
+		}
 	}
-	
+
 	sema_down (&lock->semaphore);
 	cur->lock = NULL;
 	lock->holder = cur;
+	list_push_back (&cur->held_locks, &lock->elem);
+	lock_stat_record (lock->stat, holder, holder != NULL ? rdtsc () - start : 0);
+
+	/* Threads still waiting now donate to us. */
+	if (!thread_mlfqs)
+		donate_refresh (cur);
+	intr_set_level (old_level);
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -222,8 +277,13 @@ lock_try_acquire (struct lock *lock) {
 	ASSERT (!lock_held_by_current_thread (lock));
 
 	success = sema_try_down (&lock->semaphore);
-	if (success)
+	if (success) {
+		enum intr_level old_level = intr_disable ();
 		lock->holder = thread_current ();
+		list_push_back (&lock->holder->held_locks, &lock->elem);
+		lock_stat_record (lock->stat, NULL, 0);
+		intr_set_level (old_level);
+	}
 	return success;
 }
 
@@ -237,12 +297,14 @@ void
 lock_release (struct lock *lock) {
 	ASSERT (lock != NULL);
 	ASSERT (lock_held_by_current_thread (lock));
-	struct thread *cur = thread_current();
-	enum intr_level old_level = intr_disable();
-	donate_remove(cur, lock);
-	lock->holder = NULL;	
+	struct thread *cur = thread_current ();
+	enum intr_level old_level = intr_disable ();
+	list_remove (&lock->elem);
+	lock->holder = NULL;
+	if (!thread_mlfqs)
+		donate_refresh (cur);
 	sema_up (&lock->semaphore);
-	intr_set_level(old_level);
+	intr_set_level (old_level);
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -255,14 +317,170 @@ lock_held_by_current_thread (const struct lock *lock) {
 	return lock->holder == thread_current ();
 }
 
-/* One semaphore in a list. */
-struct semaphore_elem {
-	struct list_elem elem;              /* List element. */
-	struct semaphore semaphore;         /* This semaphore. */
-};
+/* Returns the statistics entry for locks named NAME, creating
+   it if necessary.  Names are compared as stored, truncated to
+   fit an entry.  Unnamed locks, and any names beyond the table's
+   capacity, get the shared first entry. */
+static struct lock_stat *
+lock_stat_lookup (const char *name) {
+	enum intr_level old_level;
+	struct lock_stat *s = &lock_stats[0];
+	char key[sizeof s->name];
+	size_t i;
+
+	if (name == NULL)
+		return s;
+
+	strlcpy (key, name, sizeof key);
+	old_level = intr_disable ();
+	for (i = 1; i < lock_stat_cnt; i++)
+		if (!strcmp (lock_stats[i].name, key)) {
+			s = &lock_stats[i];
+			break;
+		}
+	if (i == lock_stat_cnt && lock_stat_cnt < LOCK_STAT_MAX) {
+		s = &lock_stats[lock_stat_cnt++];
+		strlcpy (s->name, key, sizeof s->name);
+	}
+	intr_set_level (old_level);
+	return s;
+}
+
+/* Counts an acquisition under S.  If HOLDER is non-null, the
+   acquirer had to wait WAIT_CYCLES for HOLDER to release it.
+   Holders are ranked with the "space saving" heuristic: a new
+   holder evicts the one with the lowest count and inherits it. */
+static void
+lock_stat_record (struct lock_stat *s, const struct thread *holder,
+		uint64_t wait_cycles) {
+	int i, min;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	s->acquired++;
+	if (holder == NULL)
+		return;
+
+	s->contended++;
+	s->wait_cycles += wait_cycles;
+	if (wait_cycles > s->max_wait_cycles)
+		s->max_wait_cycles = wait_cycles;
+
+	min = 0;
+	for (i = 0; i < LOCK_STAT_HOLDERS; i++) {
+		if (s->holders[i].cnt == 0 || !strcmp (s->holders[i].name, holder->name))
+			break;
+		if (s->holders[i].cnt < s->holders[min].cnt)
+			min = i;
+	}
+	if (i == LOCK_STAT_HOLDERS)
+		i = min;
+	if (s->holders[i].cnt == 0 || strcmp (s->holders[i].name, holder->name))
+		strlcpy (s->holders[i].name, holder->name, sizeof s->holders[i].name);
+	s->holders[i].cnt++;
+}
+
+/* Prints the statistics of every contended lock, longest total
+   wait first.  Also reachable from user programs via int 0x47. */
+void
+lock_print_stats (void) {
+	struct lock_stat *sorted[LOCK_STAT_MAX];
+	size_t cnt = 0;
+	size_t i, j;
+
+	for (i = 0; i < lock_stat_cnt; i++)
+		if (lock_stats[i].contended > 0) {
+			struct lock_stat *s = &lock_stats[i];
+
+			for (j = cnt++; j > 0 && sorted[j - 1]->wait_cycles < s->wait_cycles; j--)
+				sorted[j] = sorted[j - 1];
+			sorted[j] = s;
+		}
+	if (cnt == 0)
+		return;
+
+	printf ("Locks: %-15s %10s %10s %14s %12s  %s\n", "name", "acquired",
+			"contended", "wait cycles", "max wait", "top holders");
+	for (i = 0; i < cnt; i++) {
+		struct lock_stat *s = sorted[i];
+
+		printf ("Locks: %-15s %10"PRIu64" %10"PRIu64" %14"PRIu64" %12"PRIu64" ",
+				s->name, s->acquired, s->contended, s->wait_cycles,
+				s->max_wait_cycles);
+		for (j = 0; j < LOCK_STAT_HOLDERS && s->holders[j].cnt > 0; j++)
+			printf (" %s:%"PRIu64, s->holders[j].name, s->holders[j].cnt);
+		printf ("\n");
+	}
+}
+
+static void
+inspect_locks (struct intr_frame *f UNUSED) {
+	lock_print_stats ();
+}
+
+/* Lets user programs dump the lock statistics with int 0x47.
+   Call after intr_init(). */
+void
+lock_stat_init (void) {
+	intr_register_int (0x47, 3, INTR_ON, inspect_locks, "Dump Lock Statistics");
+}
 
-static bool cmp_sema(const struct semaphore_elem *a, const struct semaphore_elem *b, void *aux UNUSED);
-static int get_sema_prior(const struct semaphore_elem *sema);
+/* Priority donation.
+
+   A thread's priority is the greatest of its own priority,
+   org_prior, and the priorities of the threads waiting for the
+   locks it holds.  Each lock's semaphore keeps its waiters in a
+   priority heap, so a lock's highest waiter is found in O(1),
+   and a thread's donated priority in time proportional to the
+   number of locks it holds, never to the number of waiters. */
+
+/* Returns the priority of the highest-priority thread waiting
+   for LOCK, or PRI_MIN - 1 if none is. */
+static int
+lock_max_waiter (struct lock *lock) {
+	struct wait_elem *e = lock->semaphore.waiters.root;
+	return e != NULL ? wait_elem_thread (e)->priority : PRI_MIN - 1;
+}
+
+/* Passes DONOR's priority to the holder of LOCK, and on to the
+   holder of the lock that one is waiting for, and so on, until
+   reaching a holder that already has at least that priority.
+   Interrupts must be off. */
+static void
+donate (struct thread *donor, struct lock *lock) {
+	int priority = donor->priority;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	while (lock != NULL && lock->holder != NULL
+			&& lock->holder->priority < priority) {
+		struct thread *holder = lock->holder;
+
+		thread_change_priority (holder, priority);
+		sched_trace_donate (donor, holder);
+		lock = holder->lock;
+	}
+}
+
+/* Recomputes T's priority from its own priority and the waiters
+   for the locks it holds, after one of those changed.  T must
+   not be waiting for a lock.  Interrupts must be off. */
+void
+donate_refresh (struct thread *t) {
+	int priority = t->org_prior;
+	struct list_elem *e;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (t->lock == NULL);
+
+	for (e = list_begin (&t->held_locks); e != list_end (&t->held_locks);
+			e = list_next (e)) {
+		int waiter = lock_max_waiter (list_entry (e, struct lock, elem));
+		if (waiter > priority)
+			priority = waiter;
+	}
+	thread_change_priority (t, priority);
+}
 
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
@@ -271,7 +489,7 @@ void
 cond_init (struct condition *cond) {
 	ASSERT (cond != NULL);
 
-	list_init (&cond->waiters);
+	wait_queue_init (&cond->waiters);
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -296,17 +514,23 @@ cond_init (struct condition *cond) {
    we need to sleep. */
 void
 cond_wait (struct condition *cond, struct lock *lock) {
-	struct semaphore_elem waiter;
+	struct thread *cur = thread_current ();
+	enum intr_level old_level;
 
 	ASSERT (cond != NULL);
 	ASSERT (lock != NULL);
 	ASSERT (!intr_context ());
 	ASSERT (lock_held_by_current_thread (lock));
 
-	sema_init (&waiter.semaphore, 0);
-	list_push_back(&cond->waiters, &waiter.elem);
+	/* The waiter queues itself, rather than a semaphore of its
+	   own, so that its place follows its priority.  It may be
+	   signaled, and so leave the queue, even before it blocks. */
+	old_level = intr_disable ();
+	wait_queue_push (&cond->waiters, cur);
 	lock_release (lock);
-	sema_down (&waiter.semaphore);
+	while (cur->wait_elem.queue != NULL)
+		thread_block ();
+	intr_set_level (old_level);
 	lock_acquire (lock);
 }
 
@@ -324,11 +548,13 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED) {
 	ASSERT (!intr_context ());
 	ASSERT (lock_held_by_current_thread (lock));
 
-	if (!list_empty (&cond->waiters)){
-		list_sort(&cond->waiters, cmp_sema, NULL);
-		sema_up (&list_entry (list_pop_front (&cond->waiters),
-					struct semaphore_elem, elem)->semaphore);
+	enum intr_level old_level = intr_disable ();
+	if (!wait_queue_empty (&cond->waiters)) {
+		struct thread *t = wait_queue_pop (&cond->waiters);
+		if (t->status == THREAD_BLOCKED)
+			thread_unblock (t);
 	}
+	intr_set_level (old_level);
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -342,48 +568,271 @@ cond_broadcast (struct condition *cond, struct lock *lock) {
 	ASSERT (cond != NULL);
 	ASSERT (lock != NULL);
 
-	while (!list_empty (&cond->waiters))
+	while (!wait_queue_empty (&cond->waiters))
 		cond_signal (cond, lock);
 }
 
-bool cmp_sema(const struct semaphore_elem *a, const struct semaphore_elem *b, void *aux UNUSED) {
-    return get_sema_prior(a) > get_sema_prior(b);
+/* Initializes RW as free. */
+void
+rwlock_init (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	lock_init (&rw->lock);
+	rw->readers = 0;
+	rw->writer_waiting = false;
+	sema_init (&rw->drained, 0);
+}
+
+/* Acquires RW for reading, sleeping while a writer holds it or
+   is waiting for it.  Readers only pass through RW's lock, so
+   they do not receive donations while they hold RW.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (!intr_context ());
+
+	lock_acquire (&rw->lock);
+	old_level = intr_disable ();
+	rw->readers++;
+	intr_set_level (old_level);
+	lock_release (&rw->lock);
+}
+
+/* Tries to acquire RW for reading without sleeping.  Returns
+   true if successful, false if a writer holds it or is waiting
+   for it. */
+bool
+rwlock_try_acquire_read (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+
+	if (!lock_try_acquire (&rw->lock))
+		return false;
+	old_level = intr_disable ();
+	rw->readers++;
+	intr_set_level (old_level);
+	lock_release (&rw->lock);
+	return true;
+}
+
+/* Releases RW, which the current thread holds for reading. */
+void
+rwlock_release_read (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (rw->readers > 0);
+
+	old_level = intr_disable ();
+	if (--rw->readers == 0 && rw->writer_waiting) {
+		rw->writer_waiting = false;
+		sema_up (&rw->drained);
+	}
+	intr_set_level (old_level);
 }
 
-int get_sema_prior(const struct semaphore_elem *sema){
-	if(list_empty(&sema->semaphore.waiters))
-		return 0;
-	return list_entry(list_front(&sema->semaphore.waiters), struct thread, elem)->priority;
+/* Acquires RW for writing, sleeping until no other writer holds
+   it and its readers have left.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (!intr_context ());
+
+	lock_acquire (&rw->lock);
+	old_level = intr_disable ();
+	if (rw->readers > 0) {
+		rw->writer_waiting = true;
+		sema_down (&rw->drained);
+	}
+	intr_set_level (old_level);
 }
 
-void donate(struct lock *lock){
-	struct thread *h = lock->holder;
-	list_sort(&h->prior_his, cmp_prior_elem, NULL);
-	struct thread *first = list_entry(list_front(&h->prior_his), struct thread, prior_elem);
-	if(h->priority < first->priority){
-		h->priority = first->priority;
-		if(h->lock != NULL)
-			donate(h->lock);
+/* Tries to acquire RW for writing without sleeping.  Returns
+   true if successful, false if anyone else holds it. */
+bool
+rwlock_try_acquire_write (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	if (!lock_try_acquire (&rw->lock))
+		return false;
+	if (rw->readers > 0) {
+		lock_release (&rw->lock);
+		return false;
 	}
+	return true;
 }
 
-void donate_remove(struct thread *holder, struct lock *lock){
-	struct list_elem *e;
-	for (e = list_begin (&holder->prior_his); e != list_end (&holder->prior_his); e = list_next (e))
-		if(list_entry(e, struct thread, prior_elem)->lock == lock)
-			list_remove(e);
-	
-	if(list_empty(&holder->prior_his))
-		holder->priority = holder->org_prior;
-	else{
-		struct thread *first = list_entry(list_front(&holder->prior_his), struct thread, prior_elem);
-		holder->priority = max(first->priority, holder->org_prior);//);holder->org_prior holder->priority
+/* Releases RW, which the current thread holds for writing. */
+void
+rwlock_release_write (struct rwlock *rw) {
+	ASSERT (rwlock_held_for_write (rw));
+
+	lock_release (&rw->lock);
+}
+
+/* Returns true if the current thread holds RW for writing. */
+bool
+rwlock_held_for_write (const struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	return lock_held_by_current_thread (&rw->lock) && !rw->writer_waiting;
+}
+
+/* Wait queues. */
+
+/* Returns the thread that contains wait queue element E. */
+static struct thread *
+wait_elem_thread (struct wait_elem *e) {
+	return (struct thread *) ((uint8_t *) e
+			- offsetof (struct thread, wait_elem));
+}
+
+/* Returns true if A should leave its queue before B. */
+static bool
+wait_elem_before (struct wait_elem *a, struct wait_elem *b) {
+	int pa = wait_elem_thread (a)->priority;
+	int pb = wait_elem_thread (b)->priority;
+	return pa > pb || (pa == pb && a->seq < b->seq);
+}
+
+/* Melds heaps A and B, either of which may be null, and returns
+   the root of the result.  Both must be detached roots. */
+static struct wait_elem *
+wait_elem_meld (struct wait_elem *a, struct wait_elem *b) {
+	if (a == NULL)
+		return b;
+	if (b == NULL)
+		return a;
+	if (wait_elem_before (b, a)) {
+		struct wait_elem *tmp = a;
+		a = b;
+		b = tmp;
+	}
+
+	/* B becomes A's first child. */
+	b->prev = a;
+	b->next = a->child;
+	if (a->child != NULL)
+		a->child->prev = b;
+	a->child = b;
+	return a;
+}
+
+/* Melds the list of siblings starting at FIRST into one heap, in
+   the usual two passes: pairs left to right, then the pairs
+   right to left.  Returns its root. */
+static struct wait_elem *
+wait_elem_merge_pairs (struct wait_elem *first) {
+	struct wait_elem *pairs = NULL;
+	struct wait_elem *root = NULL;
+
+	while (first != NULL) {
+		struct wait_elem *a = first;
+		struct wait_elem *b = a->next;
+
+		first = b != NULL ? b->next : NULL;
+		a->next = a->prev = NULL;
+		if (b != NULL)
+			b->next = b->prev = NULL;
+		a = wait_elem_meld (a, b);
+		a->next = pairs;
+		pairs = a;
+	}
+	while (pairs != NULL) {
+		struct wait_elem *p = pairs;
+
+		pairs = p->next;
+		p->next = NULL;
+		root = wait_elem_meld (root, p);
 	}
+	return root;
+}
+
+/* Takes E, with its subtree, out of its queue Q. */
+static void
+wait_elem_remove (struct wait_queue *q, struct wait_elem *e) {
+	struct wait_elem *children = wait_elem_merge_pairs (e->child);
+
+	if (q->root == e)
+		q->root = children;
+	else {
+		if (e->prev->child == e)
+			e->prev->child = e->next;
+		else
+			e->prev->next = e->next;
+		if (e->next != NULL)
+			e->next->prev = e->prev;
+		q->root = wait_elem_meld (q->root, children);
+	}
+	e->child = e->next = e->prev = NULL;
+	e->queue = NULL;
+}
+
+/* Puts E, which is not in any queue, into Q at the place its
+   thread's priority and its arrival order call for. */
+static void
+wait_elem_insert (struct wait_queue *q, struct wait_elem *e) {
+	e->child = e->next = e->prev = NULL;
+	e->queue = q;
+	q->root = wait_elem_meld (q->root, e);
 }
 
+/* Initializes Q as empty. */
+void
+wait_queue_init (struct wait_queue *q) {
+	ASSERT (q != NULL);
+	q->root = NULL;
+}
+
+/* Returns true if Q has no waiters. */
 bool
-cmp_prior_elem(const struct list_elem *a, const struct list_elem *b, void *aux){
-	struct thread *t_a = list_entry(a, struct thread, prior_elem);
-	struct thread *t_b = list_entry(b, struct thread, prior_elem);
-	return t_a->priority > t_b->priority;
-}
\ No newline at end of file
+wait_queue_empty (const struct wait_queue *q) {
+	return q->root == NULL;
+}
+
+/* Adds T to the back of its priority in Q. */
+void
+wait_queue_push (struct wait_queue *q, struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (t->wait_elem.queue == NULL);
+
+	t->wait_elem.seq = wait_seq++;
+	wait_elem_insert (q, &t->wait_elem);
+}
+
+/* Removes and returns the highest-priority, longest-waiting
+   thread in Q, which must not be empty. */
+struct thread *
+wait_queue_pop (struct wait_queue *q) {
+	struct wait_elem *e = q->root;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (e != NULL);
+
+	wait_elem_remove (q, e);
+	return wait_elem_thread (e);
+}
+
+/* Moves T within its wait queue after a change to its priority,
+   keeping its arrival order. */
+void
+wait_queue_requeue (struct thread *t) {
+	struct wait_queue *q = t->wait_elem.queue;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (q != NULL);
+
+	wait_elem_remove (q, &t->wait_elem);
+	wait_elem_insert (q, &t->wait_elem);
+}
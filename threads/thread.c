@@ -2,14 +2,22 @@
 #include <debug.h>
 #include <stddef.h>
 #include <random.h>
+#include <rusage.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/flags.h"
+#include "threads/init.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
+#include "threads/mmu.h"
+#include "threads/mp.h"
 #include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/sched-trace.h"
+#include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 #include "intrinsic.h"
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -24,10 +32,77 @@
    Do not modify this value. */
 #define THREAD_BASIC 0xd42df210
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
-static struct list wait_list;
+/* Run queues: processes in THREAD_READY state, that is,
+   processes that are ready to run but not actually running.
+   There is one FIFO queue per priority, and bit P of ready_mask
+   is set iff ready_queues[P] is nonempty, so the highest-priority
+   ready thread is found with a single bit scan. */
+static struct list ready_queues[PRI_MAX + 1];
+static uint64_t ready_mask;
+static size_t ready_cnt;
+
+/* All threads but the idle thread, for the MLFQS per-second
+   recompute. */
+static struct list all_list;
+
+/* Threads whose recent_cpu has changed since their priority was
+   last computed.  Under MLFQS only the running thread's
+   recent_cpu changes between once-a-second updates, so every
+   fourth tick only these need a new priority. */
+static struct list dirty_list;
+
+/* System load average, for MLFQS. */
+static fixed_t load_avg;
+
+#if PRI_MIN != 0 || PRI_MAX >= 64
+#error "ready_mask needs one bit per priority"
+#endif
+
+/* CFS run queue.  Under "-cfs" the ready threads are instead kept
+   in a red-black tree ordered by virtual runtime: the time each
+   has run, scaled down by its weight, so that heavier threads
+   age more slowly.  The scheduler always runs the thread that
+   has run least, and slices time so that within one scheduling
+   period every ready thread runs for a share of it proportional
+   to its weight.  Priority only sets the weight: the default
+   priority has weight CFS_NICE0_WEIGHT, and each step of about
+   1.6 priority levels changes the weight by 25%.
+
+   ready_cnt counts the threads in the tree, and bit 0 of
+   ready_mask is set iff it is nonempty, so that code that only
+   asks whether any thread is ready works unchanged, and
+   ready_max_priority() never reports a thread worth preempting
+   for by priority. */
+static struct rb_tree cfs_queue;
+static uint64_t cfs_min_vruntime;       /* Never decreases. */
+static long cfs_load;                   /* Weights of threads in the tree. */
+
+/* EDF real-time class.  A thread that declares, with
+   thread_set_deadline(), a budget of RUNTIME ns of CPU time in
+   every PERIOD, due DEADLINE ns into the period, runs ahead of
+   every other thread, earliest absolute deadline first.  The
+   admission test keeps the total bandwidth, the sum of
+   RUNTIME / PERIOD, within EDF_BW_MAX, which with
+   DEADLINE == PERIOD is enough for EDF to meet every deadline.
+
+   The budget is charged as the thread runs.  A thread that uses
+   it up is throttled, that is, blocked until its next period
+   begins, so that an overrunning thread cannot take time from the
+   others.  A thread that wakes up after sleeping gets a fresh
+   budget and deadline if keeping the old ones would let it exceed
+   its bandwidth (the constant bandwidth server rule).  Budgets
+   are checked at each timer tick, so a thread may overrun by up
+   to a tick; releases happen at tick boundaries too. */
+static struct rb_tree edf_queue;        /* Ready threads, by deadline. */
+static struct list edf_throttled;       /* Throttled, by release time. */
+static int64_t edf_total_bw;            /* Admitted bandwidth. */
+
+#define EDF_BW_SHIFT 20                 /* Bandwidths are fixed-point. */
+#define EDF_BW_MAX ((95 << EDF_BW_SHIFT) / 100)   /* Leave 5% to others. */
+
+#define CFS_NICE0_WEIGHT 1024
+#define CFS_LATENCY (4 * 1000000000LL / TIMER_FREQ)     /* Target period, ns. */
+#define CFS_MIN_GRANULARITY (1000000000LL / TIMER_FREQ) /* Least slice, ns. */
 
 /* Idle thread. */
 static struct thread *idle_thread;
@@ -41,6 +116,44 @@ static struct lock tid_lock;
 /* Thread destruction requests */
 static struct list destruction_req;
 
+/* Pages of recently destroyed threads, reused by thread_create()
+   without a trip through the page allocator or a full zeroing:
+   init_thread() resets the struct thread at the bottom of the
+   page, and nothing may assume the stack above it is zeroed.
+   Accessed with interrupts off.  palloc trims it when the kernel
+   pool runs dry. */
+#define THREAD_CACHE_MAX 8
+static void *thread_cache[THREAD_CACHE_MAX];
+static size_t thread_cache_cnt;
+
+/* The thread that owns a block, kept apart from the block itself:
+   by the time an overflowing stack reaches the guard below the
+   block, it has run over the struct thread at the block's
+   bottom. */
+struct stack_owner {
+	tid_t tid;
+	char name[16];
+};
+static struct stack_owner initial_owner;
+
+static void stack_owner_record (struct thread *);
+
+#if THREAD_STACK_PAGES > 1
+/* Multi-page thread blocks live in this region of the kernel's
+   half of the address space, which every page map shares.  Slot
+   I's block starts at STACK_REGION + (2 * I + 1) *
+   THREAD_STACK_SIZE, so that an unmapped stretch of the same size
+   lies below each one as a guard.  Each block is aligned to its
+   size, for running_thread().  Accessed with interrupts off. */
+#define STACK_REGION ((uint8_t *) 0xf000000000)
+#define STACK_SLOTS 1024
+static bool stack_slot_used[STACK_SLOTS];
+static struct stack_owner stack_owners[STACK_SLOTS];
+
+static void *stack_map (void);
+static void stack_unmap (void *);
+#endif
+
 /* Statistics. */
 static long long idle_ticks;    /* # of timer ticks spent idle. */
 static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
@@ -55,24 +168,51 @@ static unsigned thread_ticks;   /* # of timer ticks since last yield. */
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+bool thread_cfs;
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
 static struct thread *next_thread_to_run (void);
+static void ready_push (struct thread *);
+static void ready_remove (struct thread *);
+static int ready_max_priority (void);
+static int cfs_weight (const struct thread *);
+static bool cfs_tick (struct thread *);
+static void cfs_update_curr (struct thread *);
+static void cfs_switch (struct thread *curr, struct thread *next);
+static bool cfs_less (const struct rb_elem *, const struct rb_elem *,
+		void *aux);
+static bool ready_empty (void);
+static bool edf_less (const struct rb_elem *, const struct rb_elem *,
+		void *aux);
+static bool edf_release_less (const struct list_elem *,
+		const struct list_elem *, void *aux);
+static bool edf_tick (struct thread *);
+static void edf_charge (struct thread *);
+static void edf_release (void);
+static void mlfqs_tick (struct thread *);
+static void mlfqs_second (void);
+static void mlfqs_update_priority (struct thread *);
 static void init_thread (struct thread *, const char *name, int priority);
 static void do_schedule(int status);
 static void schedule (void);
 static tid_t allocate_tid (void);
+static void *thread_page_alloc (void);
+static void thread_page_free (void *);
 
 /* Returns true if T appears to point to a valid thread. */
 #define is_thread(t) ((t) != NULL && (t)->magic == THREAD_MAGIC)
 
 /* Returns the running thread.
  * Read the CPU's stack pointer `rsp', and then round that
- * down to the start of a page.  Since `struct thread' is
- * always at the beginning of a page and the stack pointer is
- * somewhere in the middle, this locates the curent thread. */
-#define running_thread() ((struct thread *) (pg_round_down (rrsp ())))
+ * down to the start of its block.  Since `struct thread' is
+ * always at the beginning of a block and the stack pointer is
+ * somewhere in the middle, this locates the curent thread.  The
+ * initial thread's block, set up by start.S at the bottom of
+ * physical memory, is aligned for any block size. */
+#define running_thread() \
+	((struct thread *) (rrsp () & ~((uint64_t) THREAD_STACK_SIZE - 1)))
 
 
 // Global descriptor table for the thread_start.
@@ -95,7 +235,11 @@ static uint64_t gdt[3] = { 0, 0x00af9a000000ffff, 0x00cf92000000ffff };
    finishes. */
 void
 thread_init (void) {
+	int i;
+
 	ASSERT (intr_get_level () == INTR_OFF);
+	if (thread_mlfqs && thread_cfs)
+		PANIC ("-mlfqs and -cfs cannot be used together");
 
 	/* Reload the temporal gdt for the kernel
 	 * This gdt does not include the user context.
@@ -107,9 +251,14 @@ thread_init (void) {
 	lgdt (&gdt_ds);
 
 	/* Init the globla thread context */
-	lock_init (&tid_lock);
-	list_init (&ready_list);
-	list_init (&wait_list); /* init wait_list */
+	lock_init_named (&tid_lock, "tid");
+	for (i = PRI_MIN; i <= PRI_MAX; i++)
+		list_init (&ready_queues[i]);
+	rb_init (&cfs_queue, cfs_less, NULL);
+	rb_init (&edf_queue, edf_less, NULL);
+	list_init (&edf_throttled);
+	list_init (&all_list);
+	list_init (&dirty_list);
 	
 	list_init (&destruction_req);
 
@@ -119,7 +268,8 @@ thread_init (void) {
 	initial_thread->status = THREAD_RUNNING;
 	// initial_thread->pml4 = pml4_create();
 	initial_thread->tid = allocate_tid ();
-	initial_thread->wait_time = 0;
+	stack_owner_record (initial_thread);
+	sched_trace_create (initial_thread);
 }
 
 /* Starts preemptive thread scheduling by enabling interrupts.
@@ -138,25 +288,34 @@ thread_start (void) {
 	sema_down (&idle_started);
 }
 
-/* Called by the timer interrupt handler at each timer tick.
-   Thus, this function runs in an external interrupt context. */
+/* Called by the timer interrupt handler at each timer tick, with
+   USER true if the tick interrupted user code.  Thus, this
+   function runs in an external interrupt context. */
 void
-thread_tick (void) {
+thread_tick (bool user) {
 	struct thread *t = thread_current ();
 
 	/* Update statistics. */
 	if (t == idle_thread)
 		idle_ticks++;
-#ifdef USERPROG
-	else if (t->pml4 != NULL)
+	else if (user)
 		user_ticks++;
-#endif
 	else
 		kernel_ticks++;
+	if (user)
+		t->cpu_user_ticks++;
+	else
+		t->cpu_kernel_ticks++;
+
+	if (thread_mlfqs)
+		mlfqs_tick (t);
 
 	/* Enforce preemption. */
-	if (++thread_ticks >= TIME_SLICE)
+	if (edf_tick (t) || (!t->edf
+				&& (thread_cfs ? cfs_tick (t) : ++thread_ticks >= TIME_SLICE))) {
+		sched_trace_slice (t);
 		intr_yield_on_return ();
+	}
 }
 
 /* Prints thread statistics. */
@@ -166,6 +325,38 @@ thread_print_stats (void) {
 			idle_ticks, kernel_ticks, user_ticks);
 }
 
+/* Converts CYCLES of the TSC to nanoseconds, or to 0 before the
+   TSC has been calibrated. */
+static int64_t
+cycles_to_ns (uint64_t cycles) {
+	uint64_t hz = timer_tsc_hz ();
+
+	if (hz == 0)
+		return 0;
+	return cycles / hz * 1000000000 + cycles % hz * 1000000000 / hz;
+}
+
+/* Stores T's CPU usage into USAGE. */
+void
+thread_get_rusage (const struct thread *t, struct rusage *usage) {
+	enum intr_level old_level;
+	uint64_t ready_cycles, blocked_cycles;
+
+	ASSERT (is_thread (t));
+
+	old_level = intr_disable ();
+	usage->user_ticks = t->cpu_user_ticks;
+	usage->kernel_ticks = t->cpu_kernel_ticks;
+	usage->voluntary_switches = t->nvcsw;
+	usage->involuntary_switches = t->nivcsw;
+	ready_cycles = t->ready_cycles;
+	blocked_cycles = t->blocked_cycles;
+	intr_set_level (old_level);
+
+	usage->ready_ns = cycles_to_ns (ready_cycles);
+	usage->blocked_ns = cycles_to_ns (blocked_cycles);
+}
+
 /* Creates a new kernel thread named NAME with the given initial
    PRIORITY, which executes FUNCTION passing AUX as the argument,
    and adds it to the ready queue.  Returns the thread identifier
@@ -190,13 +381,20 @@ thread_create (const char *name, int priority,
 	ASSERT (function != NULL);
 
 	/* Allocate thread. */
-	t = palloc_get_page (PAL_ZERO);
+	t = thread_page_alloc ();
 	if (t == NULL)
 		return TID_ERROR;
 
 	/* Initialize thread. */
 	init_thread (t, name, priority);
 	tid = t->tid = allocate_tid ();
+	stack_owner_record (t);
+	sched_trace_create (t);
+	t->nice = thread_current ()->nice;
+	t->recent_cpu = thread_current ()->recent_cpu;
+	if (thread_mlfqs)
+		mlfqs_update_priority (t);
+	t->vruntime = cfs_min_vruntime;
 
 	/* Call the kernel_thread if it scheduled.
 	 * Note) rdi is 1st argument, and rsi is 2nd argument. */
@@ -228,6 +426,7 @@ void
 thread_block (void) {
 	ASSERT (!intr_context ());
 	ASSERT (intr_get_level () == INTR_OFF);
+	sched_trace_block (thread_current (), __builtin_return_address (0));
 	thread_current ()->status = THREAD_BLOCKED;
 	schedule ();
 }
@@ -243,12 +442,38 @@ thread_block (void) {
 void
 thread_unblock (struct thread *t) {
 	enum intr_level old_level;
+	uint64_t now;
 
 	ASSERT (is_thread (t));
 
 	old_level = intr_disable ();
 	ASSERT (t->status == THREAD_BLOCKED);
-	list_insert_ordered(&ready_list, &t->elem, cmp_prior, NULL);
+	sched_trace_wakeup (t);
+	if (t->edf) {
+		/* Keep the current deadline only if the budget left can be
+		   spent before it without exceeding T's bandwidth. */
+		int64_t ns = timer_now_ns ();
+		int64_t bw = (t->edf_runtime << EDF_BW_SHIFT) / t->edf_period;
+
+		if (t->edf_deadline <= ns
+				|| (t->edf_budget << EDF_BW_SHIFT) / (t->edf_deadline - ns) > bw) {
+			t->edf_deadline = ns + t->edf_rel_deadline;
+			t->edf_budget = t->edf_runtime;
+		}
+		/* The time T spent blocked is not charged to its budget. */
+		t->edf_charged = ns;
+	} else if (thread_cfs) {
+		/* Credit a sleeper with up to half a period of lag, no more,
+		   so that it runs soon but cannot hog the CPU to catch up. */
+		uint64_t floor = cfs_min_vruntime > CFS_LATENCY / 2
+			? cfs_min_vruntime - CFS_LATENCY / 2 : 0;
+		if (t->vruntime < floor)
+			t->vruntime = floor;
+	}
+	now = rdtsc ();
+	t->blocked_cycles += now - t->state_tsc;
+	t->state_tsc = now;
+	ready_push (t);
 	t->status = THREAD_READY;
 
 	intr_set_level (old_level);
@@ -297,6 +522,12 @@ thread_exit (void) {
 	/* Just set our status to dying and schedule another process.
 	   We will be destroyed during the call to schedule_tail(). */
 	intr_disable ();
+	if (thread_current ()->edf)
+		edf_total_bw -= (thread_current ()->edf_runtime << EDF_BW_SHIFT)
+			/ thread_current ()->edf_period;
+	list_remove (&thread_current ()->allelem);
+	if (thread_current ()->mlfqs_dirty)
+		list_remove (&thread_current ()->dirty_elem);
 	do_schedule (THREAD_DYING);
 	NOT_REACHED ();
 }
@@ -310,12 +541,28 @@ thread_yield (void) {
 
 	ASSERT (!intr_context ());
 
-	if (list_empty(&ready_list))
-		return;
-
 	old_level = intr_disable ();
+	if (curr->edf) {
+		edf_charge (curr);
+		if (curr->edf_budget <= 0) {
+			/* Throttle until the next period. */
+			curr->edf_release = curr->edf_deadline - curr->edf_rel_deadline
+				+ curr->edf_period;
+			list_insert_ordered (&edf_throttled, &curr->elem,
+					edf_release_less, NULL);
+			do_schedule (THREAD_BLOCKED);
+			intr_set_level (old_level);
+			return;
+		}
+	}
+	if (ready_empty ()) {
+		intr_set_level (old_level);
+		return;
+	}
+	if (thread_cfs)
+		cfs_update_curr (curr);
 	if(curr != idle_thread)
-		list_insert_ordered (&ready_list, &curr->elem, cmp_prior, NULL);
+		ready_push (curr);
 	
 	do_schedule (THREAD_READY);
 	intr_set_level (old_level);
@@ -326,14 +573,45 @@ void
 thread_set_priority (int new_priority) {
 	enum intr_level old_level;
 	struct thread *cur = thread_current (); 
-	cur->priority = new_priority;
+
+	bool yield;
+
+	if (thread_mlfqs)
+		return;
+
+	old_level = intr_disable ();
 	cur->org_prior = new_priority;
+	donate_refresh (cur);
+	yield = cur->priority < ready_max_priority ();
+	intr_set_level (old_level);
+
+	if (yield)
+		thread_yield ();
+}
+
+/* Sets T's effective priority to PRIORITY, moving T to the
+   matching run queue if it is ready, or within its wait queue if
+   it is waiting on one.  Used for donation. */
+void
+thread_change_priority (struct thread *t, int priority) {
+	enum intr_level old_level;
+
+	ASSERT (is_thread (t));
+	ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
 
-	if (!list_empty(&cur->prior_his)){
-		cur->priority = max(new_priority, list_entry(list_begin(&cur->prior_his), struct thread, prior_elem)->priority);
+	old_level = intr_disable ();
+	if (t->priority != priority) {
+		bool ready = t->status == THREAD_READY;
+
+		if (ready)
+			ready_remove (t);
+		t->priority = priority;
+		if (ready)
+			ready_push (t);
+		if (t->wait_elem.queue != NULL)
+			wait_queue_requeue (t);
 	}
-	if (new_priority < list_entry(list_begin(&ready_list), struct thread, elem)->priority) 
-		thread_yield();
+	intr_set_level (old_level);
 }
 
 /* Returns the current thread's priority. */
@@ -344,29 +622,120 @@ thread_get_priority (void) {
 
 /* Sets the current thread's nice value to NICE. */
 void
-thread_set_nice (int nice UNUSED) {
-	/* TODO: Your implementation goes here */
+thread_set_nice (int nice) {
+	struct thread *cur = thread_current ();
+	enum intr_level old_level;
+	bool yield;
+
+	ASSERT (NICE_MIN <= nice && nice <= NICE_MAX);
+
+	old_level = intr_disable ();
+	cur->nice = nice;
+	mlfqs_update_priority (cur);
+	yield = cur->priority < ready_max_priority ();
+	intr_set_level (old_level);
+
+	if (yield)
+		thread_yield ();
 }
 
 /* Returns the current thread's nice value. */
 int
 thread_get_nice (void) {
-	/* TODO: Your implementation goes here */
-	return 0;
+	return thread_current ()->nice;
 }
 
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg (void) {
-	/* TODO: Your implementation goes here */
-	return 0;
+	enum intr_level old_level = intr_disable ();
+	int load = fp_round (fp_mul_int (load_avg, 100));
+	intr_set_level (old_level);
+	return load;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int
 thread_get_recent_cpu (void) {
-	/* TODO: Your implementation goes here */
-	return 0;
+	enum intr_level old_level = intr_disable ();
+	int recent = fp_round (fp_mul_int (thread_current ()->recent_cpu, 100));
+	intr_set_level (old_level);
+	return recent;
+}
+
+/* MLFQS work for one timer tick, in which T was running.
+   Charges the tick to T, and recomputes load_avg and every
+   thread's recent_cpu once a second and the priorities of
+   threads that have run every fourth tick.  Run queues are
+   bucketed by priority, so a new priority costs O(1) per thread
+   and never resorts anything. */
+static void
+mlfqs_tick (struct thread *t) {
+	int64_t ticks = timer_ticks ();
+
+	if (t != idle_thread) {
+		t->recent_cpu = fp_add_int (t->recent_cpu, 1);
+		if (!t->mlfqs_dirty) {
+			t->mlfqs_dirty = true;
+			list_push_back (&dirty_list, &t->dirty_elem);
+		}
+	}
+
+	if (ticks % TIMER_FREQ == 0)
+		mlfqs_second ();
+
+	if (ticks % 4 == 0) {
+		while (!list_empty (&dirty_list)) {
+			struct thread *d = list_entry (list_pop_front (&dirty_list),
+					struct thread, dirty_elem);
+			d->mlfqs_dirty = false;
+			mlfqs_update_priority (d);
+		}
+		if (t != idle_thread && t->priority < ready_max_priority ())
+			intr_yield_on_return ();
+	}
+}
+
+/* Once-a-second MLFQS update of load_avg and of every thread's
+   recent_cpu.  Marks every thread dirty, since all their
+   priorities may have changed. */
+static void
+mlfqs_second (void) {
+	int ready_threads = ready_cnt;
+	fixed_t coef;
+	struct list_elem *e;
+
+	if (thread_current () != idle_thread)
+		ready_threads++;
+	load_avg = fp_add (fp_mul (fp_div_int (fp_from_int (59), 60), load_avg),
+			fp_mul_int (fp_div_int (fp_from_int (1), 60), ready_threads));
+
+	coef = fp_div (fp_mul_int (load_avg, 2),
+			fp_add_int (fp_mul_int (load_avg, 2), 1));
+	for (e = list_begin (&all_list); e != list_end (&all_list);
+			e = list_next (e)) {
+		struct thread *t = list_entry (e, struct thread, allelem);
+
+		t->recent_cpu = fp_add_int (fp_mul (coef, t->recent_cpu), t->nice);
+		if (!t->mlfqs_dirty) {
+			t->mlfqs_dirty = true;
+			list_push_back (&dirty_list, &t->dirty_elem);
+		}
+	}
+}
+
+/* Recomputes T's MLFQS priority from its recent_cpu and nice,
+   as PRI_MAX - (recent_cpu / 4) - (nice * 2), truncated. */
+static void
+mlfqs_update_priority (struct thread *t) {
+	int priority = PRI_MAX - fp_trunc (fp_div_int (t->recent_cpu, 4))
+		- t->nice * 2;
+
+	if (priority < PRI_MIN)
+		priority = PRI_MIN;
+	else if (priority > PRI_MAX)
+		priority = PRI_MAX;
+	thread_change_priority (t, priority);
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
@@ -383,13 +752,32 @@ idle (void *idle_started_ UNUSED) {
 	struct semaphore *idle_started = idle_started_;
 
 	idle_thread = thread_current ();
+	cpus[0].idle = idle_thread;
+
+	/* The idle thread takes no part in MLFQS accounting. */
+	intr_disable ();
+	list_remove (&idle_thread->allelem);
+	intr_enable ();
+
 	sema_up (idle_started);
 
 	for (;;) {
 		/* Let someone else run. */
 		intr_disable ();
+		timer_idle_exit ();
 		thread_block ();
 
+		/* Nothing else wants the CPU, so spend the time zeroing
+		   pages for later PAL_ZERO allocations.  Stop as soon as an
+		   interrupt has made some thread ready. */
+		intr_enable ();
+		while (ready_empty () && palloc_prezero_page ())
+			continue;
+		intr_disable ();
+		if (!ready_empty ())
+			continue;
+		timer_idle_enter ();
+
 		/* Re-enable interrupts and wait for the next one.
 
 		   The `sti' instruction disables interrupts until the
@@ -421,6 +809,8 @@ kernel_thread (thread_func *function, void *aux) {
    NAME. */
 static void
 init_thread (struct thread *t, const char *name, int priority) {
+	enum intr_level old_level;
+
 	ASSERT (t != NULL);
 	ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
 	ASSERT (name != NULL);
@@ -428,13 +818,17 @@ init_thread (struct thread *t, const char *name, int priority) {
 	memset (t, 0, sizeof *t);
 	t->status = THREAD_BLOCKED;
 	strlcpy (t->name, name, sizeof t->name);
-	t->tf.rsp = (uint64_t) t + PGSIZE - sizeof (void *);
+	t->tf.rsp = (uint64_t) t + THREAD_STACK_SIZE - sizeof (void *);
 	t->priority = priority;
 	t->org_prior = priority;
 	t->magic = THREAD_MAGIC;
-	t->wait_time = 0;
-	list_init(&t->prior_his);
+	list_init (&t->held_locks);
 	t->lock = NULL;
+	t->state_tsc = rdtsc ();
+
+	old_level = intr_disable ();
+	list_push_back (&all_list, &t->allelem);
+	intr_set_level (old_level);
 }
 
 /* Chooses and returns the next thread to be scheduled.  Should
@@ -444,10 +838,363 @@ init_thread (struct thread *t, const char *name, int priority) {
    idle_thread. */
 static struct thread *
 next_thread_to_run (void) {
-	if (list_empty (&ready_list))
+	struct thread *t;
+	int pri;
+
+	if (!rb_empty (&edf_queue)) {
+		t = rb_entry (rb_min (&edf_queue), struct thread, edf_elem);
+		ready_remove (t);
+		return t;
+	}
+	if (ready_mask == 0)
 		return idle_thread;
-	else
-		return list_entry (list_pop_front (&ready_list), struct thread, elem);
+	if (thread_cfs) {
+		t = rb_entry (rb_min (&cfs_queue), struct thread, cfs_elem);
+		ready_remove (t);
+		return t;
+	}
+	pri = ready_max_priority ();
+	t = list_entry (list_pop_front (&ready_queues[pri]), struct thread, elem);
+	ready_cnt--;
+	if (list_empty (&ready_queues[pri]))
+		ready_mask &= ~(1ULL << pri);
+	return t;
+}
+
+/* Appends T to the run queue for its priority.  Interrupts must
+   be off. */
+static void
+ready_push (struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (t->edf) {
+		rb_insert (&edf_queue, &t->edf_elem);
+		return;
+	}
+	if (thread_cfs) {
+		rb_insert (&cfs_queue, &t->cfs_elem);
+		cfs_load += cfs_weight (t);
+		ready_mask = 1;
+	} else {
+		list_push_back (&ready_queues[t->priority], &t->elem);
+		ready_mask |= 1ULL << t->priority;
+	}
+	ready_cnt++;
+}
+
+/* Removes ready thread T from its run queue.  Interrupts must be
+   off. */
+static void
+ready_remove (struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (t->edf) {
+		rb_remove (&edf_queue, &t->edf_elem);
+		return;
+	}
+	ready_cnt--;
+	if (thread_cfs) {
+		rb_remove (&cfs_queue, &t->cfs_elem);
+		cfs_load -= cfs_weight (t);
+		if (ready_cnt == 0)
+			ready_mask = 0;
+	} else {
+		list_remove (&t->elem);
+		if (list_empty (&ready_queues[t->priority]))
+			ready_mask &= ~(1ULL << t->priority);
+	}
+}
+
+/* Returns the highest priority of any ready thread, or -1 if no
+   thread is ready.  A ready real-time thread counts as PRI_MAX +
+   1, above every priority. */
+static int
+ready_max_priority (void) {
+	if (!rb_empty (&edf_queue))
+		return PRI_MAX + 1;
+	return ready_mask != 0 ? 63 - __builtin_clzll (ready_mask) : -1;
+}
+
+/* Returns true if no thread is ready. */
+static bool
+ready_empty (void) {
+	return ready_mask == 0 && rb_empty (&edf_queue);
+}
+
+/* CFS weights by nice value, -20 to 19: each step is about 25%,
+   so that a thread one step nicer than another gets about 10%
+   less CPU time than it when the two compete. */
+static const int cfs_weights[40] = {
+	/* -20 */ 88761, 71755, 56483, 46273, 36291,
+	/* -15 */ 29154, 23254, 18705, 14949, 11916,
+	/* -10 */  9548,  7620,  6100,  4904,  3906,
+	/*  -5 */  3121,  2501,  1991,  1586,  1277,
+	/*   0 */  1024,   820,   655,   526,   423,
+	/*   5 */   335,   272,   215,   172,   137,
+	/*  10 */   110,    87,    70,    56,    45,
+	/*  15 */    36,    29,    23,    18,    15,
+};
+
+/* Returns T's CFS weight, which follows its priority: PRI_MAX
+   weighs as nice -20, PRI_DEFAULT as nice 0 and PRI_MIN as nice
+   19. */
+static int
+cfs_weight (const struct thread *t) {
+	int nice = (PRI_DEFAULT - t->priority) * 20 / (PRI_MAX - PRI_DEFAULT + 1);
+	return cfs_weights[nice - NICE_MIN];
+}
+
+/* Orders threads by virtual runtime. */
+static bool
+cfs_less (const struct rb_elem *a_, const struct rb_elem *b_,
+		void *aux UNUSED) {
+	const struct thread *a = rb_entry (a_, struct thread, cfs_elem);
+	const struct thread *b = rb_entry (b_, struct thread, cfs_elem);
+	return a->vruntime < b->vruntime;
+}
+
+/* Advances cfs_min_vruntime to the least virtual runtime among
+   the running thread CURR and the ready threads, if that is
+   greater. */
+static void
+cfs_update_min_vruntime (struct thread *curr) {
+	uint64_t min = UINT64_MAX;
+
+	if (curr != idle_thread && curr->status == THREAD_RUNNING)
+		min = curr->vruntime;
+	if (!rb_empty (&cfs_queue)) {
+		struct thread *first = rb_entry (rb_min (&cfs_queue),
+				struct thread, cfs_elem);
+		if (first->vruntime < min)
+			min = first->vruntime;
+	}
+	if (min != UINT64_MAX && min > cfs_min_vruntime)
+		cfs_min_vruntime = min;
+}
+
+/* Charges running thread T for the time it has run since it was
+   last charged.  T must not be in the CFS run queue. */
+static void
+cfs_update_curr (struct thread *t) {
+	int64_t now = timer_now_ns ();
+	int64_t delta = now - t->exec_start;
+
+	t->exec_start = now;
+	if (t == idle_thread || delta <= 0)
+		return;
+	t->slice_exec += delta;
+	t->vruntime += (uint64_t) delta * CFS_NICE0_WEIGHT / cfs_weight (t);
+	cfs_update_min_vruntime (t);
+}
+
+/* Returns running thread T's time slice in ns: its weighted share
+   of a period of CFS_LATENCY, stretched when so many threads are
+   ready that each would get less than CFS_MIN_GRANULARITY. */
+static int64_t
+cfs_slice (const struct thread *t) {
+	int64_t nr = ready_cnt + 1;
+	int64_t period = CFS_LATENCY;
+	int64_t slice;
+	long weight = cfs_weight (t);
+
+	if (nr * CFS_MIN_GRANULARITY > period)
+		period = nr * CFS_MIN_GRANULARITY;
+	slice = period * weight / (cfs_load + weight);
+	return slice > CFS_MIN_GRANULARITY ? slice : CFS_MIN_GRANULARITY;
+}
+
+/* CFS work for one timer tick, in which T was running.  Returns
+   true if T should yield: because it has used up its slice, or
+   because it is a slice's worth of virtual runtime ahead of the
+   thread that has run least. */
+static bool
+cfs_tick (struct thread *t) {
+	struct thread *first;
+	int64_t slice;
+
+	if (t == idle_thread)
+		return ready_cnt > 0;
+
+	cfs_update_curr (t);
+	slice = cfs_slice (t);
+	if (t->slice_exec >= slice)
+		return true;
+	if (t->slice_exec < CFS_MIN_GRANULARITY || rb_empty (&cfs_queue))
+		return false;
+	first = rb_entry (rb_min (&cfs_queue), struct thread, cfs_elem);
+	return t->vruntime > first->vruntime + slice;
+}
+
+/* Charges CURR, which is giving up the CPU, and starts NEXT's
+   slice.  A ready CURR was already charged when it was queued. */
+static void
+cfs_switch (struct thread *curr, struct thread *next) {
+	if (curr->status != THREAD_READY)
+		cfs_update_curr (curr);
+	next->exec_start = timer_now_ns ();
+	next->slice_exec = 0;
+	cfs_update_min_vruntime (next);
+}
+
+/* Makes the running thread a real-time thread with a budget of
+   RUNTIME ns of CPU time in every PERIOD ns, to be used within
+   DEADLINE ns of the start of each period, or changes the
+   parameters of a thread that already is one.  Returns false,
+   changing nothing, if the parameters are invalid or admitting
+   the thread would overcommit the CPU. */
+bool
+thread_set_deadline (int64_t runtime, int64_t deadline, int64_t period) {
+	struct thread *cur = thread_current ();
+	enum intr_level old_level;
+	int64_t bw, old_bw = 0;
+
+	if (runtime <= 0 || runtime > deadline || deadline > period
+			|| period > (INT64_MAX >> EDF_BW_SHIFT))
+		return false;
+	bw = (runtime << EDF_BW_SHIFT) / period;
+
+	old_level = intr_disable ();
+	if (cur->edf)
+		old_bw = (cur->edf_runtime << EDF_BW_SHIFT) / cur->edf_period;
+	if (edf_total_bw - old_bw + bw > EDF_BW_MAX) {
+		intr_set_level (old_level);
+		return false;
+	}
+	edf_total_bw += bw - old_bw;
+
+	cur->edf = true;
+	cur->edf_runtime = runtime;
+	cur->edf_rel_deadline = deadline;
+	cur->edf_period = period;
+	cur->edf_charged = timer_now_ns ();
+	cur->edf_deadline = cur->edf_charged + deadline;
+	cur->edf_budget = runtime;
+	intr_set_level (old_level);
+
+	/* Let a thread with an earlier deadline run. */
+	thread_yield ();
+	return true;
+}
+
+/* Returns the running thread to the normal class, releasing its
+   real-time bandwidth. */
+void
+thread_clear_deadline (void) {
+	struct thread *cur = thread_current ();
+	enum intr_level old_level;
+	bool yield;
+
+	old_level = intr_disable ();
+	if (cur->edf) {
+		edf_total_bw -= (cur->edf_runtime << EDF_BW_SHIFT) / cur->edf_period;
+		cur->edf = false;
+	}
+	yield = cur->priority < ready_max_priority ();
+	intr_set_level (old_level);
+
+	if (yield)
+		thread_yield ();
+}
+
+/* Gives up the rest of the running real-time thread's budget,
+   sleeping until its next period begins.  A periodic thread calls
+   this once its work for the period is done. */
+void
+thread_yield_period (void) {
+	struct thread *cur = thread_current ();
+	enum intr_level old_level;
+
+	ASSERT (cur->edf);
+
+	old_level = intr_disable ();
+	edf_charge (cur);
+	cur->edf_budget = 0;
+	intr_set_level (old_level);
+	thread_yield ();
+}
+
+/* Returns the time, in ns since boot, at which the first
+   throttled real-time thread is due to be released, or INT64_MAX
+   if none is throttled.  Interrupts must be off. */
+int64_t
+thread_edf_next_release (void) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (list_empty (&edf_throttled))
+		return INT64_MAX;
+	return list_entry (list_front (&edf_throttled), struct thread,
+			elem)->edf_release;
+}
+
+/* Orders real-time threads by absolute deadline. */
+static bool
+edf_less (const struct rb_elem *a_, const struct rb_elem *b_,
+		void *aux UNUSED) {
+	const struct thread *a = rb_entry (a_, struct thread, edf_elem);
+	const struct thread *b = rb_entry (b_, struct thread, edf_elem);
+	return a->edf_deadline < b->edf_deadline;
+}
+
+/* Orders throttled threads by release time. */
+static bool
+edf_release_less (const struct list_elem *a_, const struct list_elem *b_,
+		void *aux UNUSED) {
+	const struct thread *a = list_entry (a_, struct thread, elem);
+	const struct thread *b = list_entry (b_, struct thread, elem);
+	return a->edf_release < b->edf_release;
+}
+
+/* Charges real-time thread T's budget for the time it has run
+   since it was last charged.  Interrupts must be off. */
+static void
+edf_charge (struct thread *t) {
+	int64_t now = timer_now_ns ();
+
+	t->edf_budget -= now - t->edf_charged;
+	t->edf_charged = now;
+}
+
+/* EDF work for one timer tick, in which T was running.  Releases
+   throttled threads that are due, and returns true if T should
+   yield: because T is a real-time thread that has used up its
+   budget, or because a real-time thread with an earlier deadline
+   is ready, which for a normal thread is any at all. */
+static bool
+edf_tick (struct thread *t) {
+	struct thread *first;
+
+	if (!list_empty (&edf_throttled))
+		edf_release ();
+	if (t->edf) {
+		edf_charge (t);
+		if (t->edf_budget <= 0)
+			return true;
+	}
+	if (rb_empty (&edf_queue))
+		return false;
+	first = rb_entry (rb_min (&edf_queue), struct thread, edf_elem);
+	return !t->edf || first->edf_deadline < t->edf_deadline;
+}
+
+/* Releases the throttled threads whose next period has begun,
+   with a full budget and a new deadline.  Interrupts must be
+   off. */
+static void
+edf_release (void) {
+	int64_t now = timer_now_ns ();
+
+	while (!list_empty (&edf_throttled)) {
+		struct thread *t = list_entry (list_front (&edf_throttled),
+				struct thread, elem);
+
+		if (t->edf_release > now)
+			break;
+		list_pop_front (&edf_throttled);
+		t->edf_deadline = t->edf_release + t->edf_rel_deadline;
+		t->edf_budget = t->edf_runtime;
+		t->edf_charged = now;
+		thread_unblock (t);
+	}
 }
 
 /* Use iretq to launch the thread */
@@ -490,61 +1237,19 @@ do_iret (struct intr_frame *tf) {
    added at the end of the function. */
 static void
 thread_launch (struct thread *th) {
-	uint64_t tf_cur = (uint64_t) &running_thread ()->tf;
-	uint64_t tf = (uint64_t) &th->tf;
+	struct thread *curr = running_thread ();
 	ASSERT (intr_get_level () == INTR_OFF);
 
 	/* The main switching logic.
-	 * We first restore the whole execution context into the intr_frame
-	 * and then switching to the next thread by calling do_iret.
-	 * Note that, we SHOULD NOT use any stack from here
-	 * until switching is done. */
-	__asm __volatile (
-			/* Store registers that will be used. */
-			"push %%rax\n"
-			"push %%rbx\n"
-			"push %%rcx\n"
-			/* Fetch input once */
-			"movq %0, %%rax\n"
-			"movq %1, %%rcx\n"
-			"movq %%r15, 0(%%rax)\n"
-			"movq %%r14, 8(%%rax)\n"
-			"movq %%r13, 16(%%rax)\n"
-			"movq %%r12, 24(%%rax)\n"
-			"movq %%r11, 32(%%rax)\n"
-			"movq %%r10, 40(%%rax)\n"
-			"movq %%r9, 48(%%rax)\n"
-			"movq %%r8, 56(%%rax)\n"
-			"movq %%rsi, 64(%%rax)\n"
-			"movq %%rdi, 72(%%rax)\n"
-			"movq %%rbp, 80(%%rax)\n"
-			"movq %%rdx, 88(%%rax)\n"
-			"pop %%rbx\n"              // Saved rcx
-			"movq %%rbx, 96(%%rax)\n"
-			"pop %%rbx\n"              // Saved rbx
-			"movq %%rbx, 104(%%rax)\n"
-			"pop %%rbx\n"              // Saved rax
-			"movq %%rbx, 112(%%rax)\n"
-			"addq $120, %%rax\n"
-			"movw %%es, (%%rax)\n"
-			"movw %%ds, 8(%%rax)\n"
-			"addq $32, %%rax\n"
-			"call __next\n"         // read the current rip.
-			"__next:\n"
-			"pop %%rbx\n"
-			"addq $(out_iret -  __next), %%rbx\n"
-			"movq %%rbx, 0(%%rax)\n" // rip
-			"movw %%cs, 8(%%rax)\n"  // cs
-			"pushfq\n"
-			"popq %%rbx\n"
-			"mov %%rbx, 16(%%rax)\n" // eflags
-			"mov %%rsp, 24(%%rax)\n" // rsp
-			"movw %%ss, 32(%%rax)\n"
-			"mov %%rcx, %%rdi\n"
-			"call do_iret\n"
-			"out_iret:\n"
-			: : "g"(tf_cur), "g" (tf) : "memory"
-			);
+	 * A thread that has run before was switched away from here, and
+	 * only needs its callee-saved registers and stack back.  A new
+	 * thread starts from its intr_frame through do_iret.  Either way
+	 * the current thread saves just its callee-saved registers, and
+	 * resumes by returning from thread_switch*(). */
+	if (th->switch_rsp != 0)
+		thread_switch (&curr->switch_rsp, th->switch_rsp);
+	else
+		thread_switch_new (&curr->switch_rsp, &th->tf);
 }
 
 /* Schedules a new process. At entry, interrupts must be off.
@@ -558,12 +1263,30 @@ do_schedule(int status) {
 	while (!list_empty (&destruction_req)) {
 		struct thread *victim =
 			list_entry (list_pop_front (&destruction_req), struct thread, elem);
-		palloc_free_page(victim);
+		thread_page_free (victim);
 	}
 	thread_current ()->status = status;
 	schedule ();
 }
 
+/* Charges the time since their last status change to CURR, which
+   is giving up the CPU, and NEXT, which has been waiting for it,
+   and counts CURR's context switch.  Interrupts must be off. */
+static void
+account_switch (struct thread *curr, struct thread *next) {
+	uint64_t now = rdtsc ();
+
+	if (curr != next) {
+		if (curr->status == THREAD_BLOCKED)
+			curr->nvcsw++;
+		else if (curr->status == THREAD_READY)
+			curr->nivcsw++;
+	}
+	curr->state_tsc = now;
+	next->ready_cycles += now - next->state_tsc;
+	next->state_tsc = now;
+}
+
 static void
 schedule (void) {
 	struct thread *curr = running_thread ();
@@ -572,8 +1295,17 @@ schedule (void) {
 	ASSERT (intr_get_level () == INTR_OFF);
 	ASSERT (curr->status != THREAD_RUNNING);
 	ASSERT (is_thread (next));
+	account_switch (curr, next);
+	/* Charge CURR's budget up to now and start NEXT's clock, so
+	   that neither pays for time the other ran. */
+	if (curr->edf)
+		edf_charge (curr);
+	if (next->edf)
+		next->edf_charged = timer_now_ns ();
 	/* Mark us as running. */
 	next->status = THREAD_RUNNING;
+	if (thread_cfs)
+		cfs_switch (curr, next);
 
 	/* Start new time slice. */
 	thread_ticks = 0;
@@ -596,12 +1328,192 @@ schedule (void) {
 			list_push_back (&destruction_req, &curr->elem);
 		}
 
+		sched_trace_switch (curr, next);
+
 		/* Before switching the thread, we first save the information
 		 * of current running. */
 		thread_launch (next);
 	}
 }
 
+/* Returns a block for a new thread, from the cache if possible,
+   or a null pointer if memory is exhausted. */
+static void *
+thread_page_alloc (void) {
+	enum intr_level old_level = intr_disable ();
+	void *page = thread_cache_cnt > 0 ? thread_cache[--thread_cache_cnt] : NULL;
+	intr_set_level (old_level);
+
+	if (page != NULL)
+		return page;
+#if THREAD_STACK_PAGES > 1
+	return stack_map ();
+#else
+	return palloc_get_page (PAL_ZERO);
+#endif
+}
+
+/* Releases the block of a dead thread, keeping it in the cache
+   if there is room.  Interrupts must be off. */
+static void
+thread_page_free (void *page) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (thread_cache_cnt < THREAD_CACHE_MAX)
+		thread_cache[thread_cache_cnt++] = page;
+	else {
+#if THREAD_STACK_PAGES > 1
+		stack_unmap (page);
+#else
+		palloc_free_page (page);
+#endif
+	}
+}
+
+#if THREAD_STACK_PAGES > 1
+/* Claims a slot in the stack region and backs its block with
+   fresh kernel pages.  Returns the block, or a null pointer if
+   slots or memory are exhausted. */
+static void *
+stack_map (void) {
+	enum intr_level old_level;
+	uint8_t *block;
+	size_t slot;
+	int i;
+
+	old_level = intr_disable ();
+	for (slot = 0; slot < STACK_SLOTS; slot++)
+		if (!stack_slot_used[slot])
+			break;
+	if (slot < STACK_SLOTS)
+		stack_slot_used[slot] = true;
+	intr_set_level (old_level);
+	if (slot == STACK_SLOTS)
+		return NULL;
+
+	block = STACK_REGION + (2 * slot + 1) * THREAD_STACK_SIZE;
+	for (i = 0; i < THREAD_STACK_PAGES; i++) {
+		uint8_t *va = block + i * PGSIZE;
+		void *kpage = palloc_get_page (PAL_ZERO);
+		uint64_t *pte = kpage != NULL
+			? pml4e_walk (base_pml4, (uint64_t) va, 1) : NULL;
+
+		if (pte == NULL) {
+			palloc_free_page (kpage);
+			while (i-- > 0) {
+				va = block + i * PGSIZE;
+				pte = pml4e_walk (base_pml4, (uint64_t) va, 0);
+				palloc_free_page (ptov (PTE_ADDR (*pte)));
+				*pte = 0;
+				invlpg ((uint64_t) va);
+			}
+			old_level = intr_disable ();
+			stack_slot_used[slot] = false;
+			intr_set_level (old_level);
+			return NULL;
+		}
+		*pte = vtop (kpage) | PTE_P | PTE_W;
+	}
+	return block;
+}
+
+/* Unmaps BLOCK, which stack_map() returned, frees its pages and
+   releases its slot. */
+static void
+stack_unmap (void *block_) {
+	uint8_t *block = block_;
+	enum intr_level old_level;
+	int i;
+
+	ASSERT (block > STACK_REGION);
+
+	for (i = 0; i < THREAD_STACK_PAGES; i++) {
+		uint8_t *va = block + i * PGSIZE;
+		uint64_t *pte = pml4e_walk (base_pml4, (uint64_t) va, 0);
+
+		ASSERT (pte != NULL && (*pte & PTE_P));
+		palloc_free_page (ptov (PTE_ADDR (*pte)));
+		*pte = 0;
+		invlpg ((uint64_t) va);
+	}
+	old_level = intr_disable ();
+	stack_slot_used[(block - STACK_REGION) / THREAD_STACK_SIZE / 2] = false;
+	intr_set_level (old_level);
+}
+#endif
+
+/* If ADDR lies in the unmapped guard below a thread's block,
+   stores the tid and name of the thread in *TID and *NAME and
+   returns true: that thread's stack must have overflowed.
+   Otherwise returns false.  The initial thread's block, at the
+   very start of the kernel's mapping of physical memory, has
+   nothing mapped below it either. */
+bool
+thread_stack_guard_hit (const void *addr_, tid_t *tid, const char **name) {
+	const uint8_t *addr = addr_;
+	const struct stack_owner *owner = NULL;
+
+	if (initial_thread != NULL && addr < (uint8_t *) initial_thread
+			&& addr >= (uint8_t *) initial_thread - THREAD_STACK_SIZE)
+		owner = &initial_owner;
+#if THREAD_STACK_PAGES > 1
+	else if (addr >= STACK_REGION
+			&& addr < STACK_REGION + 2 * STACK_SLOTS * THREAD_STACK_SIZE) {
+		size_t unit = (addr - STACK_REGION) / THREAD_STACK_SIZE;
+
+		if (unit % 2 == 0 && stack_slot_used[unit / 2])
+			owner = &stack_owners[unit / 2];
+	}
+#endif
+	if (owner == NULL)
+		return false;
+	*tid = owner->tid;
+	*name = owner->name;
+	return true;
+}
+
+/* Records T as the owner of its block, for
+   thread_stack_guard_hit(). */
+static void
+stack_owner_record (struct thread *t) {
+	struct stack_owner *owner = NULL;
+
+	if (t == initial_thread)
+		owner = &initial_owner;
+#if THREAD_STACK_PAGES > 1
+	else if ((uint8_t *) t > STACK_REGION)
+		owner = &stack_owners[((uint8_t *) t - STACK_REGION)
+			/ THREAD_STACK_SIZE / 2];
+#endif
+	if (owner != NULL) {
+		owner->tid = t->tid;
+		strlcpy (owner->name, t->name, sizeof owner->name);
+	}
+}
+
+/* Returns every cached thread block to the page allocator.
+   Returns true if there were any. */
+bool
+thread_cache_trim (void) {
+	bool freed = false;
+
+	for (;;) {
+		enum intr_level old_level = intr_disable ();
+		void *page = thread_cache_cnt > 0
+			? thread_cache[--thread_cache_cnt] : NULL;
+		intr_set_level (old_level);
+
+		if (page == NULL)
+			return freed;
+#if THREAD_STACK_PAGES > 1
+		stack_unmap (page);
+#else
+		palloc_free_page (page);
+#endif
+		freed = true;
+	}
+}
+
 /* Returns a tid to use for a new thread. */
 static tid_t
 allocate_tid (void) {
@@ -615,33 +1527,6 @@ allocate_tid (void) {
 	return tid;
 }
 
-void thread_wait(int64_t ticks){
-	struct thread *cur = thread_current();
-	ASSERT (!intr_context ());
-
-	cur->wait_time = ticks;
-	enum intr_level old_level = intr_disable();
-	list_insert_ordered(&wait_list, &cur->elem, cmp_prior, NULL);
-	thread_block();
-	intr_set_level(old_level);
-}
-
-void thread_ready(int64_t ticks){
-	if(!list_empty(&wait_list)){
-		struct list_elem *ptr = list_front(&wait_list);
-		while(ptr != NULL){
-			struct thread *cur = list_entry(ptr ,struct thread, elem);
-			ptr = ptr->next;
-			if(cur->wait_time == ticks){
-				list_remove(&cur->elem);
-				cur->status = THREAD_READY;
-				list_insert_ordered (&ready_list, &cur->elem, cmp_prior, NULL);
-			}
-		}
-	}
-}
-
-
 bool
 cmp_prior(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED) {
     struct thread *t_a = list_entry(a, struct thread, elem);
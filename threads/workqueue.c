@@ -0,0 +1,297 @@
+#include "threads/workqueue.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Workqueues.
+
+   A workqueue is a FIFO of work items served by a fixed pool of
+   kernel threads, all running at the priority the queue was
+   created with.  Interrupt handlers and other code that must not
+   sleep or linger can queue work, which then runs later in thread
+   context, where it may sleep, take locks and do I/O.
+
+   Work items may also be delayed by some number of timer ticks.
+   Delayed items wait in a single list, shared by all queues and
+   sorted by due tick, which the timer interrupt drains through
+   workqueue_tick().
+
+   All lists here are accessed with interrupts off. */
+
+/* A queue of work items and its workers. */
+struct workqueue {
+	char name[16];              /* Name, for the workers' names. */
+	struct list pending;        /* Queued works, oldest first. */
+	struct semaphore work_cnt;  /* Counts PENDING, roughly. */
+	int running;                /* Number of works being run. */
+	struct list flushers;       /* Threads in workqueue_flush(). */
+};
+
+/* A thread waiting in workqueue_flush(). */
+struct flusher {
+	struct list_elem elem;      /* Element in a queue's flushers. */
+	struct semaphore done;      /* Upped once the queue drains. */
+};
+
+struct workqueue *system_wq;
+
+/* Delayed works of all queues, soonest due first.  Statically
+   initialized, since the timer interrupt looks at it from the
+   start. */
+static struct list delayed = LIST_INITIALIZER (delayed);
+
+static void worker (void *wq_);
+static void wake_flushers (struct workqueue *);
+
+/* Initializes the workqueue subsystem and creates system_wq.
+   Must be called after thread_start(). */
+void
+workqueue_init (void) {
+	system_wq = workqueue_create ("kworker", PRI_DEFAULT, 2);
+	if (system_wq == NULL)
+		PANIC ("cannot create system workqueue");
+}
+
+/* Creates a workqueue named NAME with WORKER_CNT worker threads
+   at PRIORITY.  Returns the new queue, or a null pointer if
+   memory or threads could not be allocated.  Workqueues are
+   never destroyed. */
+struct workqueue *
+workqueue_create (const char *name, int priority, int worker_cnt) {
+	struct workqueue *wq;
+	int i;
+
+	ASSERT (name != NULL);
+	ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
+	ASSERT (worker_cnt > 0);
+
+	wq = malloc (sizeof *wq);
+	if (wq == NULL)
+		return NULL;
+	strlcpy (wq->name, name, sizeof wq->name);
+	list_init (&wq->pending);
+	sema_init (&wq->work_cnt, 0);
+	wq->running = 0;
+	list_init (&wq->flushers);
+
+	for (i = 0; i < worker_cnt; i++) {
+		char thread_name[16];
+
+		snprintf (thread_name, sizeof thread_name, "%s/%d", name, i);
+		if (thread_create (thread_name, priority, worker, wq) == TID_ERROR) {
+			/* Workers cannot be stopped, so keep any that started. */
+			if (i == 0) {
+				free (wq);
+				return NULL;
+			}
+			break;
+		}
+	}
+	return wq;
+}
+
+/* Initializes WORK, idle, to call FUNC (AUX). */
+void
+work_init (struct work *work, work_func *func, void *aux) {
+	ASSERT (work != NULL);
+	ASSERT (func != NULL);
+
+	work->func = func;
+	work->aux = aux;
+	work->state = WORK_IDLE;
+	work->wq = NULL;
+}
+
+/* Appends WORK to WQ, to be run by its next free worker.
+   Returns false, doing nothing, if WORK is already queued or
+   delayed.  May be called from an interrupt handler. */
+bool
+queue_work (struct workqueue *wq, struct work *work) {
+	enum intr_level old_level;
+	bool queued = false;
+
+	ASSERT (wq != NULL);
+	ASSERT (work != NULL);
+
+	old_level = intr_disable ();
+	if (work->state == WORK_IDLE) {
+		work->state = WORK_QUEUED;
+		work->wq = wq;
+		list_push_back (&wq->pending, &work->elem);
+		sema_up (&wq->work_cnt);
+		queued = true;
+	}
+	intr_set_level (old_level);
+	return queued;
+}
+
+/* Returns true if work A is due before work B. */
+static bool
+expires_less (const struct list_elem *a_, const struct list_elem *b_,
+		void *aux UNUSED) {
+	const struct work *a = list_entry (a_, struct work, elem);
+	const struct work *b = list_entry (b_, struct work, elem);
+	return a->expires < b->expires;
+}
+
+/* Queues WORK on WQ once TICKS timer ticks have passed, or right
+   away if TICKS <= 0.  Returns false, doing nothing, if WORK is
+   already queued or delayed.  May be called from an interrupt
+   handler. */
+bool
+queue_delayed_work (struct workqueue *wq, struct work *work, int64_t ticks) {
+	enum intr_level old_level;
+	bool queued = false;
+
+	ASSERT (wq != NULL);
+	ASSERT (work != NULL);
+
+	if (ticks <= 0)
+		return queue_work (wq, work);
+
+	old_level = intr_disable ();
+	if (work->state == WORK_IDLE) {
+		work->state = WORK_DELAYED;
+		work->wq = wq;
+		work->expires = timer_ticks () + ticks;
+		list_insert_ordered (&delayed, &work->elem, expires_less, NULL);
+		queued = true;
+	}
+	intr_set_level (old_level);
+	return queued;
+}
+
+/* Takes WORK off its queue or its timer, if it is waiting on
+   either.  Returns true if it was, false if WORK was idle or is
+   already running.  May be called from an interrupt handler. */
+bool
+cancel_work (struct work *work) {
+	enum intr_level old_level;
+	bool canceled = true;
+
+	ASSERT (work != NULL);
+
+	old_level = intr_disable ();
+	switch (work->state) {
+		case WORK_DELAYED:
+			list_remove (&work->elem);
+			break;
+		case WORK_QUEUED:
+			/* If a worker has already taken the count for WORK, it
+			   finds the queue empty and goes back to waiting. */
+			list_remove (&work->elem);
+			sema_try_down (&work->wq->work_cnt);
+			wake_flushers (work->wq);
+			break;
+		default:
+			canceled = false;
+			break;
+	}
+	work->state = WORK_IDLE;
+	intr_set_level (old_level);
+	return canceled;
+}
+
+/* Waits until WQ has no queued works and none running.  Delayed
+   works that are not yet due are not waited for.  Must not be
+   called by one of WQ's own workers, which would wait for
+   itself. */
+void
+workqueue_flush (struct workqueue *wq) {
+	enum intr_level old_level;
+
+	ASSERT (wq != NULL);
+	ASSERT (!intr_context ());
+
+	old_level = intr_disable ();
+	while (!list_empty (&wq->pending) || wq->running > 0) {
+		struct flusher f;
+
+		sema_init (&f.done, 0);
+		list_push_back (&wq->flushers, &f.elem);
+		sema_down (&f.done);
+	}
+	intr_set_level (old_level);
+}
+
+/* Moves every delayed work due by tick NOW onto its queue.
+   Called by the timer interrupt handler. */
+void
+workqueue_tick (int64_t now) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	while (!list_empty (&delayed)) {
+		struct work *work = list_entry (list_front (&delayed),
+				struct work, elem);
+
+		if (work->expires > now)
+			break;
+		list_pop_front (&delayed);
+		work->state = WORK_IDLE;
+		queue_work (work->wq, work);
+	}
+}
+
+/* Returns the tick at which the soonest delayed work is due, or
+   INT64_MAX if there is none.  Interrupts must be off. */
+int64_t
+workqueue_next_expiry (void) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (list_empty (&delayed))
+		return INT64_MAX;
+	return list_entry (list_front (&delayed), struct work, elem)->expires;
+}
+
+/* Worker thread for workqueue WQ_. */
+static void
+worker (void *wq_) {
+	struct workqueue *wq = wq_;
+
+	for (;;) {
+		enum intr_level old_level;
+		work_func *func = NULL;
+		void *aux = NULL;
+
+		sema_down (&wq->work_cnt);
+		old_level = intr_disable ();
+		if (!list_empty (&wq->pending)) {
+			struct work *work = list_entry (list_pop_front (&wq->pending),
+					struct work, elem);
+
+			/* WORK may be freed or requeued from here on. */
+			work->state = WORK_IDLE;
+			func = work->func;
+			aux = work->aux;
+			wq->running++;
+		}
+		intr_set_level (old_level);
+		if (func == NULL)
+			continue;
+
+		func (aux);
+
+		old_level = intr_disable ();
+		wq->running--;
+		wake_flushers (wq);
+		intr_set_level (old_level);
+	}
+}
+
+/* Wakes the threads flushing WQ if WQ has drained.  Interrupts
+   must be off. */
+static void
+wake_flushers (struct workqueue *wq) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (wq->running > 0 || !list_empty (&wq->pending))
+		return;
+	while (!list_empty (&wq->flushers))
+		sema_up (&list_entry (list_pop_front (&wq->flushers),
+					struct flusher, elem)->done);
+}
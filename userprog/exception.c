@@ -1,7 +1,9 @@
 #include "userprog/exception.h"
+#include <console.h>
 #include <inttypes.h>
 #include <stdio.h>
 #include "userprog/gdt.h"
+#include "userprog/tss.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "intrinsic.h"
@@ -11,6 +13,7 @@ static long long page_fault_cnt;
 
 static void kill (struct intr_frame *);
 static void page_fault (struct intr_frame *);
+static void double_fault (struct intr_frame *);
 
 /* Registers handlers for interrupts that can be caused by user
    programs.
@@ -58,6 +61,15 @@ exception_init (void) {
 	   We need to disable interrupts for page faults because the
 	   fault address is stored in CR2 and needs to be preserved. */
 	intr_register_int (14, 0, INTR_OFF, page_fault, "#PF Page-Fault Exception");
+
+	/* A kernel stack that overflows into its guard page leaves the
+	   CPU nowhere to push the page fault's frame, which turns the
+	   fault into a double fault.  So double faults get a stack of
+	   their own.  Page faults stay on the current stack, since
+	   they may legitimately nest. */
+	intr_register_int (8, 0, INTR_OFF, double_fault,
+			"#DF Double Fault Exception");
+	intr_set_ist (8, TSS_IST_DF);
 }
 
 /* Prints exception statistics. */
@@ -105,6 +117,26 @@ kill (struct intr_frame *f) {
 	}
 }
 
+/* Double fault handler, running on the TSS's double-fault stack.
+   CR2 still holds the address of the page fault that could not be
+   delivered, so a fault in a thread's stack guard is reported as
+   that thread's stack overflow.  Either way, panics.
+
+   The stack that overflowed may hold the current thread's struct,
+   so nothing here may call thread_current(), which the console
+   lock does: the console goes lock-free first. */
+static void
+double_fault (struct intr_frame *f) {
+	const char *name;
+	tid_t tid;
+
+	console_panic ();
+	if (thread_stack_guard_hit ((void *) rcr2 (), &tid, &name))
+		PANIC ("stack overflow in thread %s (tid %d)", name, tid);
+	intr_dump_frame (f);
+	PANIC ("Kernel bug - double fault");
+}
+
 /* Page fault handler.  This is a skeleton that must be filled in
    to implement virtual memory.  Some solutions to project 2 may
    also require modifying this code.
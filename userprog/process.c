@@ -14,18 +14,56 @@
 #include "threads/init.h"
 #include "threads/interrupt.h"
 #include "threads/palloc.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/malloc.h"
 #include "threads/mmu.h"
 #include "threads/vaddr.h"
+#include "threads/workqueue.h"
 #include "intrinsic.h"
 #ifdef VM
 #include "vm/vm.h"
 #endif
 
 static void process_cleanup (void);
+static void process_free_mm (struct thread *);
 static bool load (const char *file_name, struct intr_frame *if_);
 static void initd (void *f_name);
 static void __do_fork (void *);
+static bool reap_async (struct thread *);
+static void reap (void *);
+
+/* An address space detached from an exited process, waiting to be
+ * torn down by the reaper workqueue.  Freeing every frame, swap
+ * slot and page table of a large process takes a while; doing it
+ * in the reaper keeps that cost out of exit and out of the
+ * parent's wait().  File mappings are written back and unmapped
+ * before the hand-off, since their effects must be visible once
+ * the process has exited. */
+struct dead_mm {
+	struct work work;                   /* Teardown work. */
+	uint64_t *pml4;                     /* Page map level 4. */
+#ifdef VM
+	struct supplemental_page_table spt; /* Holds its pages, moved out of
+	                                       the thread's own table. */
+#endif
+};
+
+/* Past this many queued address spaces, exiting processes tear
+ * down their own, so a starved reaper cannot hoard memory. */
+#define REAP_BACKLOG_MAX 8
+
+static struct workqueue *reap_wq;       /* Reaper, one low-priority worker. */
+static size_t reap_cnt;                 /* Address spaces queued on it. */
+static struct lock reap_lock;           /* Protects REAP_CNT. */
+
+/* Creates the low-priority workqueue that tears down the address
+ * spaces of exited processes. */
+void
+process_reaper_init (void) {
+	lock_init (&reap_lock);
+	reap_wq = workqueue_create ("reaper", PRI_MIN, 1);
+}
 
 /* General process initializer for initd and other process. */
 static void
@@ -202,6 +240,9 @@ process_exec (void *f_name) {
 
 	/* We first kill the current context */
 	process_cleanup ();
+#ifdef VM
+	supplemental_page_table_init (&thread_current ()->spt);
+#endif
 
 	token = strtok_r(file_name, " ", &save_ptr);
 	while(token != NULL){
@@ -268,6 +309,17 @@ static void
 process_cleanup (void) {
 	struct thread *curr = thread_current ();
 
+#ifdef VM
+	if (curr->pml4 != NULL)
+		spt_unmap_files (&curr->spt);
+#endif
+	if (!reap_async (curr))
+		process_free_mm (curr);
+}
+
+/* Frees CURR's address space, which must be the current one. */
+static void
+process_free_mm (struct thread *curr) {
 #ifdef VM
 	supplemental_page_table_kill (&curr->spt);
 #endif
@@ -290,6 +342,68 @@ process_cleanup (void) {
 	}
 }
 
+/* Detaches CURR's address space and queues it for the reaper.
+ * Returns false, leaving CURR untouched, if CURR has no address
+ * space, there is no reaper, or the reaper is too far behind. */
+static bool
+reap_async (struct thread *curr) {
+	struct dead_mm *mm;
+	bool queued;
+
+	if (curr->pml4 == NULL || reap_wq == NULL)
+		return false;
+	mm = malloc (sizeof *mm);
+	if (mm == NULL)
+		return false;
+
+	lock_acquire (&reap_lock);
+	queued = reap_cnt < REAP_BACKLOG_MAX;
+	if (queued)
+		reap_cnt++;
+	lock_release (&reap_lock);
+	if (!queued) {
+		free (mm);
+		return false;
+	}
+
+	/* Same ordering as in process_cleanup(): no timer interrupt
+	 * may switch back to the old page directory once it has been
+	 * handed off. */
+	mm->pml4 = curr->pml4;
+	curr->pml4 = NULL;
+	pml4_activate (NULL);
+#ifdef VM
+	mm->spt.live = false;
+	supplemental_page_table_move (&mm->spt, &curr->spt);
+#endif
+
+	work_init (&mm->work, reap, mm);
+	queue_work (reap_wq, &mm->work);
+	return true;
+}
+
+/* Reaper work for dead address space MM_.  The worker adopts it
+ * as if it were its own and frees it with process_free_mm(), so
+ * teardown code sees exactly the state it would have seen in the
+ * exiting process. */
+static void
+reap (void *mm_) {
+	struct dead_mm *mm = mm_;
+	struct thread *curr = thread_current ();
+
+	curr->pml4 = mm->pml4;
+#ifdef VM
+	supplemental_page_table_move (&curr->spt, &mm->spt);
+#endif
+	process_activate (curr);
+	process_free_mm (curr);
+	free (mm);
+
+	lock_acquire (&reap_lock);
+	reap_cnt--;
+	lock_release (&reap_lock);
+}
+
 /* Sets up the CPU for running user code in the nest thread.
  * This function is called on every context switch. */
 void
@@ -655,7 +769,11 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 
 		/* TODO: Set up aux to pass information to the lazy_load_segment. */
 		void *aux = NULL;
-		if (!vm_alloc_page_with_initializer (VM_ANON, upage,
+		if (page_read_bytes == 0) {
+			/* Nothing to read: a plain zero page. */
+			if (!vm_alloc_page (VM_ANON, upage, writable))
+				return false;
+		} else if (!vm_alloc_page_with_initializer (VM_ANON, upage,
 					writable, lazy_load_segment, aux))
 			return false;
 
@@ -1,9 +1,12 @@
 #include "userprog/syscall.h"
+#include <rusage.h>
 #include <stdio.h>
 #include <syscall-nr.h>
 #include "threads/interrupt.h"
+#include "threads/mmu.h"
 #include "threads/thread.h"
 #include "threads/loader.h"
+#include "threads/vaddr.h"
 #include "userprog/gdt.h"
 #include "threads/flags.h"
 #include "intrinsic.h"
@@ -37,10 +40,59 @@ syscall_init (void) {
 			FLAG_IF | FLAG_TF | FLAG_DF | FLAG_IOPL | FLAG_AC | FLAG_NT);
 }
 
+/* Returns true if the running process may write the SIZE bytes
+   at user address UADDR. */
+static bool
+user_buffer_writable (void *uaddr, size_t size) {
+	struct thread *curr = thread_current ();
+	uint8_t *end = (uint8_t *) uaddr + size;
+	uint8_t *p;
+
+	if (uaddr == NULL || end < (uint8_t *) uaddr || !is_user_vaddr (end - 1))
+		return false;
+	for (p = pg_round_down (uaddr); p < end; p += PGSIZE) {
+#ifdef VM
+		struct page *page = spt_find_page (&curr->spt, p);
+		if (page == NULL || !page->writable)
+			return false;
+#else
+		uint64_t *pte = pml4e_walk (curr->pml4, (uint64_t) p, 0);
+		if (pte == NULL || !(*pte & PTE_P) || !is_writable (pte))
+			return false;
+#endif
+	}
+	return true;
+}
+
+/* Stores the CPU usage of the process selected by WHO, which must
+   be RUSAGE_SELF, into USAGE.  Returns 0 if successful, -1 on
+   failure. */
+static int
+sys_getrusage (int who, struct rusage *usage) {
+	struct rusage ru;
+
+	if (who != RUSAGE_SELF || !user_buffer_writable (usage, sizeof *usage))
+		return -1;
+
+	/* A process is a single thread. */
+	thread_get_rusage (thread_current (), &ru);
+	*usage = ru;
+	return 0;
+}
+
 /* The main system call interface */
 void
-syscall_handler (struct intr_frame *f UNUSED) {
-	// TODO: Your implementation goes here.
-	printf ("system call!\n");
-	thread_exit ();
+syscall_handler (struct intr_frame *f) {
+#ifdef VM
+	thread_current ()->spt.user_rsp = f->rsp;
+#endif
+	switch (f->R.rax) {
+		case SYS_GETRUSAGE:
+			f->R.rax = sys_getrusage (f->R.rdi, (struct rusage *) f->R.rsi);
+			break;
+		default:
+			// TODO: Your implementation goes here.
+			printf ("system call!\n");
+			thread_exit ();
+	}
 }
@@ -43,7 +43,14 @@
  *      not in use, so we can always use that.  Thus, when the
  *      scheduler switches threads, it also changes the TSS's
  *      stack pointer to point to the new thread's kernel stack.
- *      (The call is in schedule in thread.c.) */
+ *      (The call is in schedule in thread.c.)
+ *
+ *  The TSS also holds the interrupt stack table, stacks that the
+ *  CPU switches to for particular interrupts regardless of ring.
+ *  We use one, for double faults, which in the kernel mostly come
+ *  from a kernel stack overflowing into an unmapped guard page:
+ *  the CPU cannot push a page fault's frame onto such a stack, so
+ *  the fault handler needs a stack of its own. */
 
 /* Kernel TSS. */
 struct task_state *tss;
@@ -55,6 +62,7 @@ tss_init (void) {
 	 * few fields of it are ever referenced, and those are the only
 	 * ones we initialize. */
 	tss = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+	tss->ist1 = (uint64_t) palloc_get_page (PAL_ASSERT) + PGSIZE;
 	tss_update (thread_current ());
 }
 
@@ -70,5 +78,5 @@ tss_get (void) {
 void
 tss_update (struct thread *next) {
 	ASSERT (tss != NULL);
-	tss->rsp0 = (uint64_t) next + PGSIZE;
+	tss->rsp0 = (uint64_t) next + THREAD_STACK_SIZE;
 }
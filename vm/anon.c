@@ -1,7 +1,11 @@
 /* anon.c: Implementation of page for non-disk image (a.k.a. anonymous page). */
 
+#include <bitmap.h>
+#include <debug.h>
 #include "vm/vm.h"
 #include "devices/disk.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
 
 /* DO NOT MODIFY BELOW LINE */
 static struct disk *swap_disk;
@@ -17,11 +21,109 @@ static const struct page_operations anon_ops = {
 	.type = VM_ANON,
 };
 
+/* Sectors per swap slot. */
+#define SECTORS_PER_SLOT (PGSIZE / DISK_SECTOR_SIZE)
+
+/* Swap devices.  The swap disk, hd1:1, is always used; with
+ * -swap-scratch, the scratch disk, hd1:0, adds capacity once it is
+ * full.  The scratch disk first carries any `put' files, so it is
+ * only attached by swap_scratch_attach() once those are copied.  Both disks sit on ATA channel 1, and devices/disk.c
+ * serializes I/O per channel, so a second device adds space but
+ * no bandwidth: slots are therefore filled device by device
+ * rather than striped.  Each device has its own slot map and
+ * lock. */
+struct swap_dev {
+	struct disk *disk;          /* Underlying disk. */
+	struct bitmap *used;        /* One bit per slot, true if in use. */
+	struct lock lock;           /* Protects USED. */
+};
+
+#define SWAP_DEV_MAX 2
+static struct swap_dev swap_devs[SWAP_DEV_MAX];
+static size_t swap_dev_cnt;
+
+bool swap_scratch;
+
+static void swap_dev_add (int chan_no, int dev_no);
+static bool swap_slot_alloc (struct anon_page *);
+static void swap_slot_free (struct anon_page *);
+
 /* Initialize the data for anonymous pages */
 void
 vm_anon_init (void) {
-	/* TODO: Set up the swap_disk. */
-	swap_disk = NULL;
+	swap_dev_add (1, 1);
+	swap_disk = swap_dev_cnt > 0 ? swap_devs[0].disk : NULL;
+}
+
+/* Adds the scratch disk as the overflow swap device, if
+ * -swap-scratch was given.  Must be called before any user process
+ * runs; later calls do nothing. */
+void
+swap_scratch_attach (void) {
+	static bool attached;
+
+	if (!swap_scratch || attached)
+		return;
+	attached = true;
+	swap_dev_add (1, 0);
+	swap_disk = swap_devs[0].disk;
+}
+
+/* Adds disk CHAN_NO:DEV_NO, if present, as a swap device. */
+static void
+swap_dev_add (int chan_no, int dev_no) {
+	struct disk *disk = disk_get (chan_no, dev_no);
+	struct swap_dev *d;
+	size_t slot_cnt;
+
+	if (disk == NULL || swap_dev_cnt >= SWAP_DEV_MAX)
+		return;
+	slot_cnt = disk_size (disk) / SECTORS_PER_SLOT;
+	if (slot_cnt == 0)
+		return;
+
+	d = &swap_devs[swap_dev_cnt];
+	d->used = bitmap_create (slot_cnt);
+	if (d->used == NULL)
+		PANIC ("swap: bitmap creation failed for hd%d:%d", chan_no, dev_no);
+	d->disk = disk;
+	lock_init (&d->lock);
+	swap_dev_cnt++;
+}
+
+/* Reserves a free slot for ANON on the first device that has one.
+ * Returns false if every device is full. */
+static bool
+swap_slot_alloc (struct anon_page *anon) {
+	size_t i;
+
+	for (i = 0; i < swap_dev_cnt; i++) {
+		struct swap_dev *d = &swap_devs[i];
+		size_t slot;
+
+		lock_acquire (&d->lock);
+		slot = bitmap_scan_and_flip (d->used, 0, 1, false);
+		lock_release (&d->lock);
+		if (slot != BITMAP_ERROR) {
+			anon->dev = d;
+			anon->slot = slot;
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Releases ANON's slot, if it has one. */
+static void
+swap_slot_free (struct anon_page *anon) {
+	struct swap_dev *d = anon->dev;
+
+	if (d == NULL)
+		return;
+	lock_acquire (&d->lock);
+	bitmap_reset (d->used, anon->slot);
+	lock_release (&d->lock);
+	anon->dev = NULL;
 }
 
 /* Initialize the file mapping */
@@ -31,22 +133,52 @@ anon_initializer (struct page *page, enum vm_type type, void *kva) {
 	page->operations = &anon_ops;
 
 	struct anon_page *anon_page = &page->anon;
+	anon_page->dev = NULL;
+	anon_page->slot = 0;
+	return true;
 }
 
 /* Swap in the page by read contents from the swap disk. */
 static bool
 anon_swap_in (struct page *page, void *kva) {
 	struct anon_page *anon_page = &page->anon;
+	disk_sector_t sector;
+	size_t i;
+
+	if (anon_page->dev == NULL)
+		return false;
+	sector = anon_page->slot * SECTORS_PER_SLOT;
+	for (i = 0; i < SECTORS_PER_SLOT; i++)
+		disk_read (anon_page->dev->disk, sector + i,
+				(uint8_t *) kva + i * DISK_SECTOR_SIZE);
+	swap_slot_free (anon_page);
+
+	vm_stat_swap (false);
+	return true;
 }
 
 /* Swap out the page by writing contents to the swap disk. */
 static bool
 anon_swap_out (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
+	disk_sector_t sector;
+	size_t i;
+
+	if (page->frame == NULL || !swap_slot_alloc (anon_page))
+		return false;
+	sector = anon_page->slot * SECTORS_PER_SLOT;
+	for (i = 0; i < SECTORS_PER_SLOT; i++)
+		disk_write (anon_page->dev->disk, sector + i,
+				(uint8_t *) page->frame->kva + i * DISK_SECTOR_SIZE);
+
+	vm_stat_swap (true);
+	return true;
 }
 
 /* Destroy the anonymous page. PAGE will be freed by the caller. */
 static void
 anon_destroy (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
+
+	swap_slot_free (anon_page);
 }
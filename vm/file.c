@@ -1,5 +1,8 @@
 /* file.c: Implementation of memory backed file object (mmaped object). */
 
+#include <string.h>
+#include "threads/mmu.h"
+#include "threads/vaddr.h"
 #include "vm/vm.h"
 
 static bool file_backed_swap_in (struct page *page, void *kva);
@@ -22,16 +25,29 @@ vm_file_init (void) {
 /* Initialize the file backed page */
 bool
 file_backed_initializer (struct page *page, enum vm_type type, void *kva) {
+	/* Fetch first: the uninit page shares storage with FILE_PAGE. */
+	struct file_load_aux *aux = page->uninit.aux;
+
 	/* Set up the handler */
 	page->operations = &file_ops;
 
 	struct file_page *file_page = &page->file;
+	file_page->file = aux->file;
+	file_page->offset = aux->offset;
+	file_page->read_bytes = aux->read_bytes;
+	return true;
 }
 
 /* Swap in the page by read contents from the file. */
 static bool
 file_backed_swap_in (struct page *page, void *kva) {
-	struct file_page *file_page UNUSED = &page->file;
+	struct file_page *file_page = &page->file;
+
+	if (file_read_at (file_page->file, kva, file_page->read_bytes,
+				file_page->offset) != (off_t) file_page->read_bytes)
+		return false;
+	memset (kva + file_page->read_bytes, 0, PGSIZE - file_page->read_bytes);
+	return true;
 }
 
 /* Swap out the page by writeback contents to the file. */
@@ -43,7 +59,13 @@ file_backed_swap_out (struct page *page) {
 /* Destory the file backed page. PAGE will be freed by the caller. */
 static void
 file_backed_destroy (struct page *page) {
-	struct file_page *file_page UNUSED = &page->file;
+	struct file_page *file_page = &page->file;
+	uint64_t *pml4 = thread_current ()->pml4;
+
+	/* Write back what the process changed. */
+	if (page->frame != NULL && pml4 != NULL && pml4_is_dirty (pml4, page->va))
+		file_write_at (file_page->file, page->frame->kva,
+				file_page->read_bytes, file_page->offset);
 }
 
 /* Do the mmap */
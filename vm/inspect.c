@@ -4,6 +4,7 @@
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
+#include "vm/vm.h"
 #include "vm/inspect.h"
 
 static void
@@ -12,12 +13,34 @@ inspect (struct intr_frame *f) {
 	f->R.rax = PTE_ADDR (pml4_get_page (thread_current ()->pml4, va));
 }
 
+static void
+inspect_stat (struct intr_frame *f) {
+	f->R.rax = vm_stat_get (f->R.rax, f->R.rdx != 0);
+}
+
+static void
+inspect_map (struct intr_frame *f UNUSED) {
+	spt_dump (&thread_current ()->spt);
+}
+
 /* Tool for testing vm component. Calling this function via int 0x42.
  * Input:
  *   @RAX - Virtual address to inspect
  * Output:
- *   @RAX - Physical address that mmaped to input. */
+ *   @RAX - Physical address that mmaped to input.
+ *
+ * Paging statistics are read via int 0x45.
+ * Input:
+ *   @RAX - Statistic to read (enum vm_stat in vm/vm.h)
+ *   @RDX - 0 for the current process, 1 for the whole system
+ * Output:
+ *   @RAX - Value of the statistic.
+ *
+ * int 0x46 prints the calling process's address-space map and
+ * resident set size to the console (see spt_dump()). */
 void
 register_inspect_intr (void) {
 	intr_register_int (0x42, 3, INTR_OFF, inspect, "Inspect Virtual Memory");
+	intr_register_int (0x45, 3, INTR_OFF, inspect_stat, "Inspect VM Statistics");
+	intr_register_int (0x46, 3, INTR_ON, inspect_map, "Dump Address Space");
 }
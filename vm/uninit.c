@@ -8,6 +8,7 @@
  * function.
  * */
 
+#include "threads/malloc.h"
 #include "vm/vm.h"
 #include "vm/uninit.h"
 
@@ -65,4 +66,8 @@ uninit_destroy (struct page *page) {
 	struct uninit_page *uninit UNUSED = &page->uninit;
 	/* TODO: Fill this function.
 	 * TODO: If you don't have anything to do, just return. */
+
+	/* A pending file page owns its struct file_load_aux. */
+	if (VM_TYPE (uninit->type) == VM_FILE)
+		free (uninit->aux);
 }
@@ -1,8 +1,24 @@
 /* vm.c: Generic interface for virtual memory objects. */
 
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/vaddr.h"
 #include "vm/vm.h"
 #include "vm/inspect.h"
+#include "intrinsic.h"
+
+/* System-wide paging statistics. */
+static struct {
+	uint64_t fault_cnt[VM_FAULT_CAUSE_CNT];     /* Faults by cause. */
+	uint64_t fault_lat[VM_FAULT_LAT_BUCKETS];   /* log2(cycles) histogram. */
+	uint64_t eviction_cnt;                      /* Frames evicted. */
+	uint64_t swap_in_cnt;                       /* Pages read from swap. */
+	uint64_t swap_out_cnt;                      /* Pages written to swap. */
+} vm_stats;
 
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
@@ -36,6 +52,12 @@ page_get_type (struct page *page) {
 static struct frame *vm_get_victim (void);
 static bool vm_do_claim_page (struct page *page);
 static struct frame *vm_evict_frame (void);
+static enum vm_fault_cause vm_fault_cause (struct page *page);
+static bool is_stack_access (const struct intr_frame *, void *addr,
+		bool user);
+
+/* Largest size the user stack may grow to. */
+#define STACK_LIMIT (1 << 20)
 
 /* Create the pending page object with initializer. If you want to create a
  * page, do not create it directly and make it through this function or
@@ -50,39 +72,74 @@ vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writable,
 
 	/* Check wheter the upage is already occupied or not. */
 	if (spt_find_page (spt, upage) == NULL) {
-		/* TODO: Create the page, fetch the initialier according to the VM type,
-		 * TODO: and then create "uninit" page struct by calling uninit_new. You
-		 * TODO: should modify the field after calling the uninit_new. */
-
-		/* TODO: Insert the page into the spt. */
+		bool (*initializer) (struct page *, enum vm_type, void *);
+		struct page *page;
+
+		switch (VM_TYPE (type)) {
+			case VM_ANON:
+				initializer = anon_initializer;
+				break;
+			case VM_FILE:
+				initializer = file_backed_initializer;
+				break;
+			default:
+				goto err;
+		}
+
+		page = malloc (sizeof *page);
+		if (page == NULL)
+			goto err;
+		uninit_new (page, pg_round_down (upage), init, type, aux, initializer);
+		page->writable = writable;
+		page->is_stack = (type & VM_STACK) != 0;
+
+		if (!spt_insert_page (spt, page)) {
+			free (page);
+			goto err;
+		}
+		return true;
 	}
 err:
 	return false;
 }
 
-/* Find VA from spt and return page. On error, return NULL. */
+/* Find VA from spt and return page. On error, return NULL.
+ * The page stays valid for SPT's owner, the only thread that
+ * removes pages; any other caller must hold SPT's lock for
+ * reading across the lookup and its use of the page.  The lock
+ * does not record its readers, so this cannot be checked. */
 struct page *
-spt_find_page (struct supplemental_page_table *spt UNUSED, void *va UNUSED) {
-	struct page *page = NULL;
-	/* TODO: Fill this function. */
+spt_find_page (struct supplemental_page_table *spt, void *va) {
+	struct page key;
+	struct hash_elem *e;
 
-	return page;
+	key.va = pg_round_down (va);
+	e = hash_find (&spt->pages, &key.spt_elem);
+	return e != NULL ? hash_entry (e, struct page, spt_elem) : NULL;
 }
 
 /* Insert PAGE into spt with validation. */
 bool
-spt_insert_page (struct supplemental_page_table *spt UNUSED,
-		struct page *page UNUSED) {
-	int succ = false;
-	/* TODO: Fill this function. */
+spt_insert_page (struct supplemental_page_table *spt,
+		struct page *page) {
+	bool success;
+
+	ASSERT (spt == &thread_current ()->spt);
 
-	return succ;
+	rwlock_acquire_write (&spt->lock);
+	success = hash_insert (&spt->pages, &page->spt_elem) == NULL;
+	rwlock_release_write (&spt->lock);
+	return success;
 }
 
 void
 spt_remove_page (struct supplemental_page_table *spt, struct page *page) {
+	ASSERT (spt == &thread_current ()->spt);
+
+	rwlock_acquire_write (&spt->lock);
+	hash_delete (&spt->pages, &page->spt_elem);
+	rwlock_release_write (&spt->lock);
 	vm_dealloc_page (page);
-	return true;
 }
 
 /* Get the struct frame, that will be evicted. */
@@ -101,6 +158,8 @@ vm_evict_frame (void) {
 	struct frame *victim UNUSED = vm_get_victim ();
 	/* TODO: swap out the victim and return the evicted frame. */
 
+	if (victim != NULL)
+		vm_stats.eviction_cnt++;
 	return NULL;
 }
 
@@ -134,10 +193,63 @@ vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
 		bool user UNUSED, bool write UNUSED, bool not_present UNUSED) {
 	struct supplemental_page_table *spt UNUSED = &thread_current ()->spt;
 	struct page *page = NULL;
+	uint64_t start = rdtsc ();
+	enum vm_fault_cause cause;
+	bool success;
 	/* TODO: Validate the fault */
 	/* TODO: Your code goes here */
 
-	return vm_do_claim_page (page);
+	/* Classify by what the SPT knows about ADDR, if anything. */
+	if (is_user_vaddr (addr))
+		page = spt_find_page (spt, addr);
+
+	if (page != NULL && write && !not_present) {
+		success = vm_handle_wp (page);
+		cause = success ? VM_FAULT_COW : VM_FAULT_WP;
+	} else if (page != NULL) {
+		cause = vm_fault_cause (page);
+		success = vm_do_claim_page (page);
+	} else if (is_stack_access (f, addr, user)) {
+		vm_stack_growth (addr);
+		cause = VM_FAULT_STACK;
+		success = vm_claim_page (addr);
+	} else {
+		cause = VM_FAULT_INVALID;
+		success = false;
+	}
+	vm_stat_fault (cause, rdtsc () - start);
+	return success;
+}
+
+/* Returns true if a fault on ADDR, described by F, looks like a
+ * push or store just below the top of the user stack: ADDR lies
+ * within STACK_LIMIT below USER_STACK and no more than 8 bytes
+ * below the user rsp, which for a fault in the kernel is the one
+ * saved at the last system call. */
+static bool
+is_stack_access (const struct intr_frame *f, void *addr_, bool user) {
+	uintptr_t addr = (uintptr_t) addr_;
+	uintptr_t rsp = user ? f->rsp : thread_current ()->spt.user_rsp;
+
+	return addr < USER_STACK && addr >= USER_STACK - STACK_LIMIT
+		&& addr + 8 >= rsp;
+}
+
+/* Classifies a not-present fault on PAGE, which is in the
+ * supplemental page table, for the statistics: a page never
+ * touched before is lazy if it has an initializer to run and a
+ * zero page if not, and one that was touched before comes back
+ * from swap or from its file. */
+static enum vm_fault_cause
+vm_fault_cause (struct page *page) {
+	switch (VM_TYPE (page->operations->type)) {
+		case VM_UNINIT:
+			return page->uninit.init != NULL ? VM_FAULT_LAZY : VM_FAULT_ZERO;
+		case VM_ANON:
+			return page->anon.dev != NULL ? VM_FAULT_SWAP_IN : VM_FAULT_ZERO;
+		default:
+			return VM_FAULT_FILE_IN;
+	}
 }
 
 /* Free the page.
@@ -151,9 +263,11 @@ vm_dealloc_page (struct page *page) {
 /* Claim the page that allocate on VA. */
 bool
 vm_claim_page (void *va UNUSED) {
-	struct page *page = NULL;
+	struct page *page = spt_find_page (&thread_current ()->spt, va);
 	/* TODO: Fill this function */
 
+	if (page == NULL)
+		return false;
 	return vm_do_claim_page (page);
 }
 
@@ -171,9 +285,34 @@ vm_do_claim_page (struct page *page) {
 	return swap_in (page, frame->kva);
 }
 
+/* Returns a hash value for the page that E belongs to. */
+static uint64_t
+page_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct page *p = hash_entry (e, struct page, spt_elem);
+	return hash_bytes (&p->va, sizeof p->va);
+}
+
+/* Returns true if page A precedes page B. */
+static bool
+page_less (const struct hash_elem *a_, const struct hash_elem *b_,
+		void *aux UNUSED) {
+	const struct page *a = hash_entry (a_, struct page, spt_elem);
+	const struct page *b = hash_entry (b_, struct page, spt_elem);
+	return a->va < b->va;
+}
+
+/* Frees the page that E belongs to. */
+static void
+page_destructor (struct hash_elem *e, void *aux UNUSED) {
+	vm_dealloc_page (hash_entry (e, struct page, spt_elem));
+}
+
 /* Initialize new supplemental page table */
 void
 supplemental_page_table_init (struct supplemental_page_table *spt UNUSED) {
+	hash_init (&spt->pages, page_hash, page_less, NULL);
+	rwlock_init (&spt->lock);
+	spt->live = true;
 }
 
 /* Copy supplemental page table from src to dst */
@@ -187,4 +326,265 @@ void
 supplemental_page_table_kill (struct supplemental_page_table *spt UNUSED) {
 	/* TODO: Destroy all the supplemental_page_table hold by thread and
 	 * TODO: writeback all the modified contents to the storage. */
+	ASSERT (spt == &thread_current ()->spt);
+
+	/* A kernel thread's table is all zeros, lock included. */
+	if (!spt->live)
+		return;
+	rwlock_acquire_write (&spt->lock);
+	hash_destroy (&spt->pages, page_destructor);
+	spt->live = false;
+	rwlock_release_write (&spt->lock);
+}
+
+/* Moves SRC's pages into DST, which must not be live, leaving
+ * SRC not live, as if it had never been initialized.  Does
+ * nothing if SRC is not live either.  Only the
+ * hash changes hands, which is safe because its buckets are on
+ * the heap; DST gets a fresh lock of its own, since a lock may
+ * have waiters that point into the structure that embeds it. */
+void
+supplemental_page_table_move (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src) {
+	ASSERT (!dst->live);
+
+	if (!src->live)
+		return;
+	rwlock_acquire_write (&src->lock);
+	dst->pages = src->pages;
+	memset (&src->pages, 0, sizeof src->pages);
+	src->live = false;
+	rwlock_release_write (&src->lock);
+
+	rwlock_init (&dst->lock);
+	dst->live = true;
+}
+
+/* Writes back and unmaps every file-backed page in SPT, pending or
+ * not.  An exiting process does this itself before handing the
+ * rest of its address space to the reaper, so that its files are
+ * up to date by the time its parent's wait() returns. */
+void
+spt_unmap_files (struct supplemental_page_table *spt) {
+	enum { BATCH = 32 };
+	struct page *batch[BATCH];
+	struct hash_iterator it;
+	size_t cnt, i;
+
+	ASSERT (spt == &thread_current ()->spt);
+
+	/* The hash cannot change under an iterator, so collect a batch,
+	 * delete it, and look again until a pass comes up short. */
+	do {
+		cnt = 0;
+		rwlock_acquire_write (&spt->lock);
+		hash_first (&it, &spt->pages);
+		while (cnt < BATCH && hash_next (&it)) {
+			struct page *p = hash_entry (hash_cur (&it), struct page, spt_elem);
+			if (page_get_type (p) == VM_FILE)
+				batch[cnt++] = p;
+		}
+		for (i = 0; i < cnt; i++)
+			hash_delete (&spt->pages, &batch[i]->spt_elem);
+		rwlock_release_write (&spt->lock);
+
+		for (i = 0; i < cnt; i++)
+			vm_dealloc_page (batch[i]);
+	} while (cnt == BATCH);
+}
+
+/* Orders pages by virtual address, for qsort(). */
+static int
+page_va_cmp (const void *a_, const void *b_) {
+	const struct page *a = *(const struct page **) a_;
+	const struct page *b = *(const struct page **) b_;
+	return a->va < b->va ? -1 : a->va > b->va;
+}
+
+/* Returns the file that backs PAGE and stores PAGE's offset in it
+ * into *OFS, or returns a null pointer if PAGE is not file-backed.
+ * A page that is still pending reports the file it will be loaded
+ * from. */
+static struct file *
+page_backing_file (struct page *page, off_t *ofs) {
+	const struct file_load_aux *aux;
+
+	switch (VM_TYPE (page->operations->type)) {
+		case VM_FILE:
+			*ofs = page->file.offset;
+			return page->file.file;
+		case VM_UNINIT:
+			if (VM_TYPE (page->uninit.type) != VM_FILE)
+				return NULL;
+			aux = page->uninit.aux;
+			*ofs = aux->offset;
+			return aux->file;
+		default:
+			return NULL;
+	}
+}
+
+/* Returns true if page B continues the region that page A ends. */
+static bool
+same_region (struct page *a, struct page *b) {
+	off_t a_ofs = 0, b_ofs = 0;
+	struct file *file = page_backing_file (a, &a_ofs);
+
+	return b->va == a->va + PGSIZE
+		&& page_get_type (b) == page_get_type (a)
+		&& b->writable == a->writable
+		&& b->is_stack == a->is_stack
+		&& page_backing_file (b, &b_ofs) == file
+		&& (file == NULL || b_ofs == a_ofs + PGSIZE);
+}
+
+/* Prints the layout of SPT to the console, one line per region of
+ * contiguous pages with the same type, permissions and backing:
+ * its address range, permissions, type, how many of its pages are
+ * resident, paged out and never touched, and the inode number and
+ * offset of the file behind it, if any. */
+void
+spt_dump (struct supplemental_page_table *spt) {
+	size_t page_cnt;
+	size_t rss = 0;
+	struct hash_iterator it;
+	struct page **pages;
+	size_t i, j;
+
+	rwlock_acquire_read (&spt->lock);
+	page_cnt = hash_size (&spt->pages);
+	printf ("Address space of %s: %zu pages\n", thread_name (), page_cnt);
+	pages = page_cnt > 0 ? malloc (page_cnt * sizeof *pages) : NULL;
+	if (pages != NULL) {
+		i = 0;
+		for (hash_first (&it, &spt->pages); hash_next (&it); )
+			pages[i++] = hash_entry (hash_cur (&it), struct page, spt_elem);
+	}
+	rwlock_release_read (&spt->lock);
+	if (page_cnt == 0)
+		return;
+	if (pages == NULL) {
+		printf ("  (out of memory)\n");
+		return;
+	}
+	qsort (pages, page_cnt, sizeof *pages, page_va_cmp);
+
+	printf ("  %-33s %-4s %-6s %8s %8s %9s  %s\n", "range", "perm", "type",
+			"resident", "paged", "untouched", "backing");
+	for (i = 0; i < page_cnt; i = j) {
+		struct page *first = pages[i];
+		off_t ofs = 0;
+		struct file *file = page_backing_file (first, &ofs);
+		size_t resident = 0, paged = 0, untouched = 0;
+		const char *type;
+
+		for (j = i; j < page_cnt; j++) {
+			struct page *p = pages[j];
+			if (j > i && !same_region (pages[j - 1], p))
+				break;
+			if (p->frame != NULL)
+				resident++;
+			else if (VM_TYPE (p->operations->type) == VM_UNINIT)
+				untouched++;
+			else
+				paged++;
+		}
+		rss += resident;
+
+		if (first->is_stack)
+			type = "stack";
+		else if (page_get_type (first) == VM_ANON)
+			type = "anon";
+		else if (page_get_type (first) == VM_FILE)
+			type = "file";
+		else
+			type = "cache";
+
+		printf ("  %016"PRIx64"-%016"PRIx64" r%c   %-6s %8zu %8zu %9zu  ",
+				(uint64_t) first->va, (uint64_t) pages[j - 1]->va + PGSIZE,
+				first->writable ? 'w' : '-', type, resident, paged, untouched);
+		if (file != NULL)
+			printf ("inode %"PRDSNu" @ %#"PRIx64"\n",
+					inode_get_inumber (file_get_inode (file)), (uint64_t) ofs);
+		else
+			printf ("-\n");
+	}
+	printf ("  RSS %zu kB\n", rss * PGSIZE / 1024);
+	free (pages);
+}
+
+/* Records a page fault of the given CAUSE that took CYCLES TSC
+ * cycles to resolve, for the current process and system-wide. */
+void
+vm_stat_fault (enum vm_fault_cause cause, uint64_t cycles) {
+	int bucket = cycles ? 63 - __builtin_clzll (cycles) : 0;
+
+	ASSERT (cause < VM_FAULT_CAUSE_CNT);
+	if (bucket >= VM_FAULT_LAT_BUCKETS)
+		bucket = VM_FAULT_LAT_BUCKETS - 1;
+
+	thread_current ()->spt.fault_cnt[cause]++;
+	vm_stats.fault_cnt[cause]++;
+	vm_stats.fault_lat[bucket]++;
+}
+
+/* Records one page of swap I/O, a write if OUT is true. */
+void
+vm_stat_swap (bool out) {
+	if (out)
+		vm_stats.swap_out_cnt++;
+	else
+		vm_stats.swap_in_cnt++;
+}
+
+/* Returns statistic STAT (see enum vm_stat) for the current
+ * process, or for the whole system if GLOBAL is true.  Only the
+ * fault counts are kept per process; the other statistics are
+ * always system-wide.  Unknown statistics read as 0. */
+uint64_t
+vm_stat_get (int stat, bool global) {
+	const struct supplemental_page_table *spt = &thread_current ()->spt;
+	uint64_t sum = 0;
+	int i;
+
+	if (stat >= 0 && stat < VM_FAULT_CAUSE_CNT)
+		return global ? vm_stats.fault_cnt[stat] : spt->fault_cnt[stat];
+	if (stat >= VM_STAT_LATENCY && stat < VM_STAT_LATENCY + VM_FAULT_LAT_BUCKETS)
+		return vm_stats.fault_lat[stat - VM_STAT_LATENCY];
+
+	switch (stat) {
+		case VM_STAT_FAULTS:
+			for (i = 0; i < VM_FAULT_CAUSE_CNT; i++)
+				sum += global ? vm_stats.fault_cnt[i] : spt->fault_cnt[i];
+			return sum;
+		case VM_STAT_EVICTIONS:
+			return vm_stats.eviction_cnt;
+		case VM_STAT_SWAP_INS:
+			return vm_stats.swap_in_cnt;
+		case VM_STAT_SWAP_OUTS:
+			return vm_stats.swap_out_cnt;
+		default:
+			return 0;
+	}
+}
+
+/* Prints paging statistics. */
+void
+vm_print_stats (void) {
+	const uint64_t *c = vm_stats.fault_cnt;
+	int i;
+
+	printf ("VM: %"PRIu64" page faults: %"PRIu64" lazy, %"PRIu64" zero, "
+			"%"PRIu64" swap-in, %"PRIu64" file-in, %"PRIu64" cow, "
+			"%"PRIu64" stack, %"PRIu64" write-protect, %"PRIu64" invalid\n",
+			vm_stat_get (VM_STAT_FAULTS, true),
+			c[VM_FAULT_LAZY], c[VM_FAULT_ZERO], c[VM_FAULT_SWAP_IN],
+			c[VM_FAULT_FILE_IN], c[VM_FAULT_COW], c[VM_FAULT_STACK],
+			c[VM_FAULT_WP], c[VM_FAULT_INVALID]);
+	printf ("VM: %"PRIu64" evictions, %"PRIu64" swap-ins, %"PRIu64" swap-outs\n",
+			vm_stats.eviction_cnt, vm_stats.swap_in_cnt, vm_stats.swap_out_cnt);
+	for (i = 0; i < VM_FAULT_LAT_BUCKETS; i++)
+		if (vm_stats.fault_lat[i] != 0)
+			printf ("VM: fault latency 2^%d cycles: %"PRIu64"\n",
+					i, vm_stats.fault_lat[i]);
 }